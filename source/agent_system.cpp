@@ -0,0 +1,192 @@
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/Scene/Node.h>
+
+#include "agent_system.h"
+#include "telemetry.h"
+
+using namespace Urho3D;
+
+// How quickly velocity turns towards the desired velocity, per second
+static const float AGENT_STEERING_RATE = 4.0f;
+// Agents slow down within this distance of their target
+static const float AGENT_SLOW_RADIUS = 4.0f;
+
+AgentSystem::AgentSystem(Context* context) :
+	LogicComponent(context),
+	bounds_(Vector3(-100.0f, 0.0f, -100.0f), Vector3(100.0f, 0.0f, 100.0f)),
+	maxSpeed_(5.0f),
+	arriveRadius_(0.5f),
+	batchSize_(1024)
+{
+	SetUpdateEventMask(USE_UPDATE);
+	workQueue_ = GetSubsystem<WorkQueue>();
+}
+
+void AgentSystem::RegisterObject(Context* context)
+{
+	context->RegisterFactory<AgentSystem>();
+
+	URHO3D_ACCESSOR_ATTRIBUTE("Is Enabled", IsEnabled, SetEnabled, bool, true, AM_DEFAULT);
+	URHO3D_ACCESSOR_ATTRIBUTE("Max Speed", GetMaxSpeed, SetMaxSpeed, float, 5.0f, AM_DEFAULT);
+	URHO3D_ACCESSOR_ATTRIBUTE("Batch Size", GetBatchSize, SetBatchSize, unsigned, 1024, AM_DEFAULT);
+}
+
+void AgentSystem::SetBatchSize(unsigned size)
+{
+	// Whole multiples of 64 agents keep batch boundaries from splitting more than one cache line of each array
+	batchSize_ = Max((size + 63) & ~63U, 64U);
+}
+
+void AgentSystem::SetWorkQueue(WorkQueue* queue)
+{
+	workQueue_ = queue;
+}
+
+unsigned AgentSystem::AddAgent(Node* node, const Vector3& position)
+{
+	unsigned index = positions_.Size();
+	unsigned seed = index * 0x9e3779b9u + 1;
+	positions_.Push(position);
+	velocities_.Push(Vector3::ZERO);
+	targets_.Push(PickTarget(seed));
+	flags_.Push(AGENT_ACTIVE | AGENT_MOVED);
+	seeds_.Push(seed);
+	nodes_.Push(WeakPtr<Node>(node));
+	return index;
+}
+
+void AgentSystem::RemoveAllAgents()
+{
+	positions_.Clear();
+	velocities_.Clear();
+	targets_.Clear();
+	flags_.Clear();
+	seeds_.Clear();
+	nodes_.Clear();
+}
+
+Vector3 AgentSystem::PickTarget(unsigned& seed) const
+{
+	// xorshift32, per agent so the result does not depend on which thread runs the batch
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	float u = (seed & 0xffff) / 65535.0f;
+	float v = (seed >> 16) / 65535.0f;
+	return Vector3(Lerp(bounds_.min_.x_, bounds_.max_.x_, u), bounds_.min_.y_,
+		Lerp(bounds_.min_.z_, bounds_.max_.z_, v));
+}
+
+void AgentSystem::Update(float timeStep)
+{
+	Simulate(timeStep);
+	WriteBack();
+}
+
+void AgentSystem::Simulate(float timeStep)
+{
+	const unsigned count = positions_.Size();
+	if (!count)
+		return;
+	TELEMETRY_SCOPE("agents.simulate");
+
+	WorkQueue* queue = workQueue_;
+	if (!queue)
+	{
+		SimulateBatch(0, count, timeStep);
+		return;
+	}
+
+	const unsigned numBatches = (count + batchSize_ - 1) / batchSize_;
+	batches_.Resize(numBatches);
+	while (items_.Size() < numBatches)
+	{
+		SharedPtr<WorkItem> item(new WorkItem());
+		item->workFunction_ = SimulateBatchWork;
+		// Highest priority lets the main thread take part while it waits in Complete()
+		item->priority_ = M_MAX_UNSIGNED;
+		items_.Push(item);
+	}
+
+	for (unsigned i = 0; i < numBatches; ++i)
+	{
+		AgentBatch& batch = batches_[i];
+		batch.owner_ = this;
+		batch.begin_ = i * batchSize_;
+		batch.end_ = Min(batch.begin_ + batchSize_, count);
+		batch.timeStep_ = timeStep;
+		items_[i]->aux_ = &batch;
+		queue->AddWorkItem(items_[i]);
+	}
+	queue->Complete(M_MAX_UNSIGNED);
+}
+
+void AgentSystem::SimulateBatchWork(const WorkItem* item, unsigned threadIndex)
+{
+	const AgentBatch* batch = reinterpret_cast<const AgentBatch*>(item->aux_);
+	batch->owner_->SimulateBatch(batch->begin_, batch->end_, batch->timeStep_);
+}
+
+void AgentSystem::SimulateBatch(unsigned begin, unsigned end, float timeStep)
+{
+	Vector3* positions = &positions_[0];
+	Vector3* velocities = &velocities_[0];
+	Vector3* targets = &targets_[0];
+	unsigned* flags = &flags_[0];
+	unsigned* seeds = &seeds_[0];
+	const float steering = Min(AGENT_STEERING_RATE * timeStep, 1.0f);
+
+	for (unsigned i = begin; i < end; ++i)
+	{
+		unsigned state = flags[i] & ~AGENT_ARRIVED;
+		if (!(state & AGENT_ACTIVE))
+		{
+			flags[i] = state;
+			continue;
+		}
+
+		Vector3 toTarget = targets[i] - positions[i];
+		toTarget.y_ = 0.0f;
+		float distance = toTarget.Length();
+		if (distance < arriveRadius_)
+		{
+			targets[i] = PickTarget(seeds[i]);
+			state |= AGENT_ARRIVED;
+			toTarget = targets[i] - positions[i];
+			toTarget.y_ = 0.0f;
+			distance = toTarget.Length();
+		}
+
+		// Seek the target, slowing down on approach
+		float speed = maxSpeed_ * Min(distance / AGENT_SLOW_RADIUS, 1.0f);
+		Vector3 desired = distance > M_EPSILON ? toTarget * (speed / distance) : Vector3::ZERO;
+		velocities[i] += (desired - velocities[i]) * steering;
+		positions[i] += velocities[i] * timeStep;
+		if (velocities[i].LengthSquared() > M_EPSILON)
+			state |= AGENT_MOVED;
+		flags[i] = state;
+	}
+}
+
+void AgentSystem::WriteBack()
+{
+	TELEMETRY_SCOPE("agents.writeback");
+
+	const unsigned count = positions_.Size();
+	for (unsigned i = 0; i < count; ++i)
+	{
+		if (!(flags_[i] & AGENT_MOVED))
+			continue;
+		flags_[i] &= ~AGENT_MOVED;
+
+		Node* node = nodes_[i];
+		if (!node)
+			continue;
+		const Vector3& velocity = velocities_[i];
+		if (velocity.LengthSquared() > M_EPSILON)
+			node->SetTransform(positions_[i], Quaternion(Atan2(velocity.x_, velocity.z_), Vector3::UP));
+		else
+			node->SetPosition(positions_[i]);
+	}
+}
@@ -0,0 +1,104 @@
+#ifndef AGENT_SYSTEM_H
+#define AGENT_SYSTEM_H
+
+#include <Urho3D/Math/BoundingBox.h>
+#include <Urho3D/Scene/LogicComponent.h>
+
+using namespace Urho3D;
+
+namespace Urho3D
+{
+	class WorkItem;
+	class WorkQueue;
+}
+
+/// Agent state flags.
+static const unsigned AGENT_ACTIVE = 0x1;
+/// Reached its target during the last step and picked a new one.
+static const unsigned AGENT_ARRIVED = 0x2;
+/// Moved during the last step; cleared by the write-back.
+static const unsigned AGENT_MOVED = 0x4;
+
+/// Simulates many wandering agents with their state kept in parallel arrays (structure of arrays). Each update
+/// splits the agents into fixed-size batches run on the WorkQueue; worker threads only read and write the arrays.
+/// The results are then copied to the agents' scene nodes in one pass on the main thread. Positions are in the
+/// local space of the component's node, and agent nodes should be its children.
+class AgentSystem : public LogicComponent
+{
+	URHO3D_OBJECT(AgentSystem, LogicComponent);
+
+public:
+	/// Construct.
+	AgentSystem(Context* context);
+	/// Register object factory and attributes.
+	static void RegisterObject(Context* context);
+
+	/// Simulate and write back.
+	virtual void Update(float timeStep);
+
+	/// Add an agent at a local-space position. The node receives the agent's transform on write-back and may be
+	/// null for agents that are only simulated. Returns the agent index.
+	unsigned AddAgent(Node* node, const Vector3& position);
+	/// Remove all agents.
+	void RemoveAllAgents();
+	/// Advance all agents by timeStep on the WorkQueue. Does not touch the scene.
+	void Simulate(float timeStep);
+	/// Copy positions and headings of agents that moved to their nodes.
+	void WriteBack();
+
+	/// Set region, in local space, where agents pick their targets.
+	void SetBounds(const BoundingBox& bounds) { bounds_ = bounds; }
+	/// Set maximum speed in units per second.
+	void SetMaxSpeed(float speed) { maxSpeed_ = Max(speed, 0.0f); }
+	/// Set agents per work item.
+	void SetBatchSize(unsigned size);
+	/// Set the work queue to run batches on. Defaults to the WorkQueue subsystem.
+	void SetWorkQueue(WorkQueue* queue);
+
+	unsigned GetNumAgents() const { return positions_.Size(); }
+	const BoundingBox& GetBounds() const { return bounds_; }
+	float GetMaxSpeed() const { return maxSpeed_; }
+	unsigned GetBatchSize() const { return batchSize_; }
+	const PODVector<Vector3>& GetPositions() const { return positions_; }
+	const PODVector<Vector3>& GetVelocities() const { return velocities_; }
+	const PODVector<Vector3>& GetTargets() const { return targets_; }
+	const PODVector<unsigned>& GetFlags() const { return flags_; }
+
+private:
+	/// Range of agents updated by one work item.
+	struct AgentBatch
+	{
+		AgentSystem* owner_;
+		unsigned begin_;
+		unsigned end_;
+		float timeStep_;
+	};
+
+	// Agent state, one element per agent in every array
+	PODVector<Vector3> positions_;
+	PODVector<Vector3> velocities_;
+	PODVector<Vector3> targets_;
+	PODVector<unsigned> flags_;
+	// Per-agent random state for picking targets
+	PODVector<unsigned> seeds_;
+	Vector<WeakPtr<Node> > nodes_;
+
+	BoundingBox bounds_;
+	float maxSpeed_;
+	float arriveRadius_;
+	unsigned batchSize_;
+	WeakPtr<WorkQueue> workQueue_;
+	// Reused every step so simulating does not allocate
+	PODVector<AgentBatch> batches_;
+	Vector<SharedPtr<WorkItem> > items_;
+
+	// Pick a new target for an agent
+	Vector3 PickTarget(unsigned& seed) const;
+	// Step agents [begin, end)
+	void SimulateBatch(unsigned begin, unsigned end, float timeStep);
+
+	// Worker thread entry point
+	static void SimulateBatchWork(const WorkItem* item, unsigned threadIndex);
+};
+
+#endif
@@ -0,0 +1,83 @@
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/ProcessUtils.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "../agent_system.h"
+#include "bench_suites.h"
+
+using namespace Urho3D;
+
+static const unsigned AGENT_BENCH_WARMUP_STEPS = 10;
+static const unsigned AGENT_BENCH_STEPS = 200;
+
+bool RunAgentBenchmark(Context* context, BenchmarkReport& report)
+{
+	const unsigned numAgents = Max(ToUInt(GetArgumentValue("agents", "50000")), 1U);
+	const float timeStep = 1.0f / 60.0f;
+
+	SharedPtr<Scene> scene(new Scene(context));
+	Node* agentsNode = scene->CreateChild("Agents", LOCAL);
+	AgentSystem* agents = agentsNode->CreateComponent<AgentSystem>(LOCAL);
+	agents->SetBounds(BoundingBox(Vector3(-500.0f, 0.0f, -500.0f), Vector3(500.0f, 0.0f, 500.0f)));
+	agents->SetBatchSize(ToUInt(GetArgumentValue("batchsize", "1024")));
+
+	// Start on a grid; every agent has a node so the write-back cost is the real one
+	const unsigned side = (unsigned)ceilf(sqrtf((float)numAgents));
+	for (unsigned i = 0; i < numAgents; ++i)
+	{
+		Vector3 position(-500.0f + 1000.0f * (i % side) / side, 0.0f, -500.0f + 1000.0f * (i / side) / side);
+		Node* node = agentsNode->CreateChild(String::EMPTY, LOCAL);
+		node->SetPosition(position);
+		agents->AddAgent(node, position);
+	}
+
+	report.Set("agents", numAgents);
+	report.Set("batchSize", agents->GetBatchSize());
+	report.Set("steps", AGENT_BENCH_STEPS);
+	report.Set("logicalCPUs", GetNumLogicalCPUs());
+	report.Set("physicalCPUs", GetNumPhysicalCPUs());
+
+	// A private WorkQueue per thread count, as the engine's queue has a fixed number of threads. The calling thread
+	// works too, so n threads means n - 1 workers
+	const unsigned threadCounts[] = { 1, 2, 4, 8 };
+	float singleThreadRate = 0.0f;
+	for (unsigned t = 0; t < sizeof(threadCounts) / sizeof(threadCounts[0]); ++t)
+	{
+		const unsigned threads = threadCounts[t];
+		SharedPtr<WorkQueue> queue(new WorkQueue(context));
+		queue->CreateThreads(threads - 1);
+		agents->SetWorkQueue(queue);
+
+		for (unsigned step = 0; step < AGENT_BENCH_WARMUP_STEPS; ++step)
+			agents->Update(timeStep);
+
+		long long simulateUSec = 0;
+		long long writeBackUSec = 0;
+		HiresTimer timer;
+		for (unsigned step = 0; step < AGENT_BENCH_STEPS; ++step)
+		{
+			timer.Reset();
+			agents->Simulate(timeStep);
+			simulateUSec += timer.GetUSec(true);
+			agents->WriteBack();
+			writeBackUSec += timer.GetUSec(false);
+		}
+
+		const float simulateMs = simulateUSec / 1000.0f;
+		const float rate = simulateMs > 0.0f ? (float)numAgents * AGENT_BENCH_STEPS / simulateMs : 0.0f;
+		if (threads == 1)
+			singleThreadRate = rate;
+
+		String key = "threads" + String(threads);
+		report.Set(key + ".simulateMsPerStep", simulateMs / AGENT_BENCH_STEPS);
+		report.Set(key + ".writeBackMsPerStep", writeBackUSec / 1000.0f / AGENT_BENCH_STEPS);
+		report.Set(key + ".agentsPerMs", rate);
+		report.Set(key + ".speedup", singleThreadRate > 0.0f ? rate / singleThreadRate : 0.0f);
+		report.Set(key + ".efficiency", singleThreadRate > 0.0f ? rate / singleThreadRate / threads : 0.0f);
+	}
+
+	agents->SetWorkQueue(context->GetSubsystem<WorkQueue>());
+	return true;
+}
@@ -0,0 +1,178 @@
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/IO/PackageFile.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "../resource_package.h"
+#include "bench_suites.h"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace Urho3D;
+
+static const char* PACKAGE_BENCH_SCENE = "Scenes/TestScene.xml";
+// Each load is repeated and the fastest run kept, to filter out scheduler noise
+static const unsigned PACKAGE_BENCH_RUNS = 5;
+// Allocation unit used to estimate space taken on disk
+static const unsigned PACKAGE_BENCH_DISK_BLOCK = 4096;
+
+// Drop files from the OS page cache so the next read comes from disk. Returns false where this is not supported or
+// any file could not be evicted
+static bool EvictFromPageCache(const Vector<String>& fileNames)
+{
+#ifdef __linux__
+	bool evicted = true;
+	for (unsigned i = 0; i < fileNames.Size(); ++i)
+	{
+		int fd = open(GetNativePath(fileNames[i]).CString(), O_RDONLY);
+		if (fd < 0)
+		{
+			evicted = false;
+			continue;
+		}
+		// POSIX_FADV_DONTNEED leaves dirty pages alone, and a freshly written package is all dirty pages
+		if (fdatasync(fd) != 0 || posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) != 0)
+			evicted = false;
+		close(fd);
+	}
+	return evicted;
+#else
+	return false;
+#endif
+}
+
+static unsigned GetDiskBlocks(unsigned size)
+{
+	return (size + PACKAGE_BENCH_DISK_BLOCK - 1) / PACKAGE_BENCH_DISK_BLOCK;
+}
+
+// Load the benchmark scene with all its resources, from the package when one is given. Returns time in
+// microseconds including mounting the package, or -1 on failure
+static long long TimeSceneLoad(Context* context, const String& packageName)
+{
+	ResourceCache* cache = context->GetSubsystem<ResourceCache>();
+	cache->ReleaseAllResources(true);
+
+	HiresTimer timer;
+	SharedPtr<PackageFile> package;
+	if (!packageName.Empty())
+	{
+		package = new PackageFile(context, packageName);
+		// Ahead of the loose directories, and first among packages
+		cache->SetSearchPackagesFirst(true);
+		if (!cache->AddPackageFile(package, 0))
+			return -1;
+	}
+	SharedPtr<Scene> scene(new Scene(context));
+	SharedPtr<File> file = cache->GetFile(PACKAGE_BENCH_SCENE);
+	bool success = file && scene->LoadXML(*file);
+	long long elapsed = timer.GetUSec(false);
+
+	if (package)
+		cache->RemovePackageFile(package, true);
+	return success ? elapsed : -1;
+}
+
+bool RunPackageBenchmark(Context* context, BenchmarkReport& report)
+{
+	ResourceCache* cache = context->GetSubsystem<ResourceCache>();
+	FileSystem* fileSystem = context->GetSubsystem<FileSystem>();
+
+	// Packages the application mounted are set aside, so the loose layout really is loose
+	Vector<SharedPtr<PackageFile> > mounted = cache->GetPackageFiles();
+	for (unsigned i = 0; i < mounted.Size(); ++i)
+		cache->RemovePackageFile(mounted[i], true);
+
+	SharedPtr<ResourcePackager> packager(new ResourcePackager(context));
+	String packageName = fileSystem->GetTemporaryDir() + "fpbench_TestScene.pak";
+	HiresTimer buildTimer;
+	bool success = packager->AddResource(PACKAGE_BENCH_SCENE) && packager->Write(packageName);
+	long long buildUSec = buildTimer.GetUSec(false);
+
+	if (success)
+	{
+		// Footprint of the same resources as loose files
+		const Vector<String>& resources = packager->GetResources();
+		Vector<String> looseFiles;
+		unsigned looseBlocks = 0;
+		for (unsigned i = 0; i < resources.Size(); ++i)
+		{
+			String fileName = cache->GetResourceFileName(resources[i]);
+			looseFiles.Push(fileName);
+			looseBlocks += GetDiskBlocks(File(context, fileName).GetSize());
+		}
+		// and of everything shipped in the resource directories
+		unsigned shippedFiles = 0;
+		unsigned shippedBytes = 0;
+		const Vector<String>& resourceDirs = cache->GetResourceDirs();
+		for (unsigned i = 0; i < resourceDirs.Size(); ++i)
+		{
+			Vector<String> files;
+			fileSystem->ScanDir(files, resourceDirs[i], "*", SCAN_FILES, true);
+			for (unsigned j = 0; j < files.Size(); ++j)
+				shippedBytes += File(context, resourceDirs[i] + files[j]).GetSize();
+			shippedFiles += files.Size();
+		}
+
+		report.Set("scene", String(PACKAGE_BENCH_SCENE));
+		report.Set("buildMs", buildUSec / 1000.0f);
+		report.Set("resources", resources.Size());
+		report.Set("looseBytes", packager->GetSourceSize());
+		report.Set("looseDiskKB", looseBlocks * PACKAGE_BENCH_DISK_BLOCK / 1024);
+		report.Set("packageBytes", packager->GetPackageSize());
+		report.Set("packageDiskKB", GetDiskBlocks(packager->GetPackageSize()) * PACKAGE_BENCH_DISK_BLOCK / 1024);
+		report.Set("shippedFiles", shippedFiles);
+		report.Set("shippedBytes", shippedBytes);
+
+		// Cold loads read from disk after the files are dropped from the page cache; warm loads straight after
+		Vector<String> packageFiles;
+		packageFiles.Push(packageName);
+		long long looseCold = M_MAX_INT;
+		long long looseWarm = M_MAX_INT;
+		long long packageCold = M_MAX_INT;
+		long long packageWarm = M_MAX_INT;
+		bool evicted = true;
+		for (unsigned run = 0; run < PACKAGE_BENCH_RUNS && success; ++run)
+		{
+			evicted &= EvictFromPageCache(looseFiles);
+			long long cold = TimeSceneLoad(context, String::EMPTY);
+			long long warm = TimeSceneLoad(context, String::EMPTY);
+			evicted &= EvictFromPageCache(packageFiles);
+			long long packedCold = TimeSceneLoad(context, packageName);
+			long long packedWarm = TimeSceneLoad(context, packageName);
+			if (cold < 0 || warm < 0 || packedCold < 0 || packedWarm < 0)
+			{
+				URHO3D_LOGERROR("Could not load " + String(PACKAGE_BENCH_SCENE));
+				success = false;
+				break;
+			}
+			looseCold = Min(looseCold, cold);
+			looseWarm = Min(looseWarm, warm);
+			packageCold = Min(packageCold, packedCold);
+			packageWarm = Min(packageWarm, packedWarm);
+		}
+
+		if (success)
+		{
+			report.Set("coldFromDisk", evicted ? 1U : 0U);
+			report.Set("loose.coldMs", looseCold / 1000.0f);
+			report.Set("loose.warmMs", looseWarm / 1000.0f);
+			report.Set("package.coldMs", packageCold / 1000.0f);
+			report.Set("package.warmMs", packageWarm / 1000.0f);
+			report.Set("coldSpeedup", packageCold > 0 ? (float)looseCold / packageCold : 0.0f);
+			report.Set("warmSpeedup", packageWarm > 0 ? (float)looseWarm / packageWarm : 0.0f);
+		}
+	}
+
+	fileSystem->Delete(packageName);
+	for (unsigned i = 0; i < mounted.Size(); ++i)
+		cache->AddPackageFile(mounted[i], i);
+	return success;
+}
@@ -0,0 +1,208 @@
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/ProcessUtils.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/Graphics/Octree.h>
+#include <Urho3D/Graphics/Terrain.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Math/Random.h>
+#include <Urho3D/Physics/CollisionShape.h>
+#include <Urho3D/Physics/PhysicsWorld.h>
+#include <Urho3D/Physics/RigidBody.h>
+#include <Urho3D/Resource/Image.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "../paged_terrain.h"
+#include "../physics_queries.h"
+#include "bench_suites.h"
+
+using namespace Urho3D;
+
+static const int PHYSICS_BENCH_TERRAIN_SIZE = 512;
+static const float PHYSICS_BENCH_TERRAIN_SPACING = 2.0f;
+static const unsigned PHYSICS_BENCH_OBSTACLES = 500;
+// Batch and reference results must agree this closely
+static const float PHYSICS_BENCH_FRACTION_TOLERANCE = 1e-4f;
+static const float PHYSICS_BENCH_POSITION_TOLERANCE = 1e-2f;
+
+// Random point in the terrain's horizontal extent at the given height range
+static Vector3 RandomPoint(float minY, float maxY)
+{
+	const float half = PHYSICS_BENCH_TERRAIN_SIZE * PHYSICS_BENCH_TERRAIN_SPACING * 0.5f;
+	return Vector3(Random(-half, half), Random(minY, maxY), Random(-half, half));
+}
+
+// Return whether a batched result agrees with a single PhysicsWorld query
+static bool Matches(const PhysicsQueryHit& hit, const PhysicsRaycastResult& reference)
+{
+	if (hit.body_ != reference.body_)
+		return false;
+	if (!hit.body_)
+		return true;
+	return Abs(hit.hitFraction_ - reference.hitFraction_) <= PHYSICS_BENCH_FRACTION_TOLERANCE &&
+		(hit.position_ - reference.position_).Length() <= PHYSICS_BENCH_POSITION_TOLERANCE;
+}
+
+bool RunPhysicsBenchmark(Context* context, BenchmarkReport& report)
+{
+	const unsigned numRays = Max(ToUInt(GetArgumentValue("queries", "100000")), 1U);
+	const unsigned numSweeps = Max(numRays / 10, 1U);
+	SetRandomSeed(1);
+
+	SharedPtr<Scene> scene(new Scene(context));
+	scene->CreateComponent<Octree>(LOCAL);
+	PhysicsWorld* physicsWorld = scene->CreateComponent<PhysicsWorld>(LOCAL);
+
+	// Synthetic heightfield terrain with heightfield collision
+	SyntheticTerrainSource source(IntVector2(PHYSICS_BENCH_TERRAIN_SIZE + 1, PHYSICS_BENCH_TERRAIN_SIZE + 1), 1);
+	PODVector<unsigned char> heights;
+	source.ReadTile(0, 0, PHYSICS_BENCH_TERRAIN_SIZE, 1, heights);
+	SharedPtr<Image> heightMap(new Image(context));
+	heightMap->SetSize(PHYSICS_BENCH_TERRAIN_SIZE + 1, PHYSICS_BENCH_TERRAIN_SIZE + 1, 3);
+	heightMap->SetData(&heights[0]);
+	Node* terrainNode = scene->CreateChild("Terrain", LOCAL);
+	Terrain* terrain = terrainNode->CreateComponent<Terrain>(LOCAL);
+	terrain->SetSpacing(Vector3(PHYSICS_BENCH_TERRAIN_SPACING, 0.25f, PHYSICS_BENCH_TERRAIN_SPACING));
+	terrain->SetHeightMap(heightMap);
+	AddTerrainCollision(terrain);
+
+	// Static boxes and spheres standing on the terrain, so queries have more than one object to choose between
+	for (unsigned i = 0; i < PHYSICS_BENCH_OBSTACLES; ++i)
+	{
+		Vector3 position = RandomPoint(0.0f, 0.0f);
+		position.y_ = terrain->GetHeight(position) + Random(0.0f, 4.0f);
+		Node* node = scene->CreateChild(String::EMPTY, LOCAL);
+		node->SetTransform(position, Quaternion(Random(360.0f), Vector3::UP));
+		node->CreateComponent<RigidBody>(LOCAL);
+		CollisionShape* shape = node->CreateComponent<CollisionShape>(LOCAL);
+		if (i & 1)
+			shape->SetBox(Vector3(Random(1.0f, 6.0f), Random(1.0f, 6.0f), Random(1.0f, 6.0f)));
+		else
+			shape->SetSphere(Random(1.0f, 6.0f));
+	}
+	// Shape for convex sweeps; it has no body of its own
+	Node* probeNode = scene->CreateChild("Probe", LOCAL);
+	CollisionShape* probeShape = probeNode->CreateComponent<CollisionShape>(LOCAL);
+	probeShape->SetBox(Vector3(1.0f, 2.0f, 1.0f));
+	physicsWorld->UpdateCollisions();
+
+	// Mostly downward rays, as for ground and line-of-sight tests, some long enough to miss everything
+	PODVector<PhysicsRayQuery> rays(numRays);
+	for (unsigned i = 0; i < numRays; ++i)
+	{
+		Vector3 from = RandomPoint(2.0f, 80.0f);
+		Vector3 to = RandomPoint(-10.0f, 20.0f);
+		rays[i].ray_ = Ray(from, to - from);
+		rays[i].maxDistance_ = (to - from).Length() * Random(0.5f, 1.5f);
+		rays[i].collisionMask_ = M_MAX_UNSIGNED;
+	}
+	PODVector<PhysicsSweepQuery> sweeps(numSweeps);
+	for (unsigned i = 0; i < numSweeps; ++i)
+	{
+		PhysicsSweepQuery& sweep = sweeps[i];
+		sweep.start_ = RandomPoint(10.0f, 60.0f);
+		sweep.end_ = sweep.start_ + Vector3(Random(-40.0f, 40.0f), Random(-60.0f, 0.0f), Random(-40.0f, 40.0f));
+		sweep.rotation_ = Quaternion(Random(360.0f), Vector3::UP);
+		sweep.radius_ = Random(0.25f, 2.0f);
+		// Every fourth sweep moves the box probe instead of a sphere
+		sweep.shape_ = (i & 3) == 3 ? probeShape : 0;
+		sweep.collisionMask_ = M_MAX_UNSIGNED;
+	}
+
+	report.Set("rays", numRays);
+	report.Set("sweeps", numSweeps);
+	report.Set("obstacles", PHYSICS_BENCH_OBSTACLES);
+	report.Set("logicalCPUs", GetNumLogicalCPUs());
+	report.Set("physicalCPUs", GetNumPhysicalCPUs());
+
+	// Reference: one PhysicsWorld query at a time on the main thread
+	PODVector<PhysicsRaycastResult> rayReference(numRays);
+	PODVector<PhysicsRaycastResult> sweepReference(numSweeps);
+	HiresTimer timer;
+	for (unsigned i = 0; i < numRays; ++i)
+		physicsWorld->RaycastSingle(rayReference[i], rays[i].ray_, rays[i].maxDistance_, rays[i].collisionMask_);
+	const long long rayReferenceUSec = timer.GetUSec(true);
+	for (unsigned i = 0; i < numSweeps; ++i)
+	{
+		const PhysicsSweepQuery& sweep = sweeps[i];
+		if (sweep.shape_)
+		{
+			physicsWorld->ConvexCast(sweepReference[i], sweep.shape_, sweep.start_, sweep.rotation_, sweep.end_,
+				sweep.rotation_, sweep.collisionMask_);
+		}
+		else
+		{
+			Vector3 delta = sweep.end_ - sweep.start_;
+			physicsWorld->SphereCast(sweepReference[i], Ray(sweep.start_, delta), sweep.radius_, delta.Length(),
+				sweep.collisionMask_);
+		}
+	}
+	const long long sweepReferenceUSec = timer.GetUSec(false);
+	report.Set("single.raysPerSec", rayReferenceUSec > 0 ? numRays * 1000000.0f / rayReferenceUSec : 0.0f);
+	report.Set("single.sweepsPerSec", sweepReferenceUSec > 0 ? numSweeps * 1000000.0f / sweepReferenceUSec : 0.0f);
+
+	unsigned rayHits = 0;
+	for (unsigned i = 0; i < numRays; ++i)
+	{
+		if (rayReference[i].body_)
+			++rayHits;
+	}
+	report.Set("rayHits", rayHits);
+
+	// A private WorkQueue per thread count, as the engine's queue has a fixed number of threads. The calling thread
+	// works too, so n threads means n - 1 workers
+	SharedPtr<PhysicsQueryBatch> batch(new PhysicsQueryBatch(context));
+	batch->SetBatchSize(ToUInt(GetArgumentValue("batchsize", "256")));
+	report.Set("batchSize", batch->GetBatchSize());
+	PODVector<PhysicsQueryHit> rayResults;
+	PODVector<PhysicsQueryHit> sweepResults;
+	unsigned rayMismatches = 0;
+	unsigned sweepMismatches = 0;
+	const unsigned threadCounts[] = { 1, 2, 4, 8 };
+	float singleThreadRate = 0.0f;
+	for (unsigned t = 0; t < sizeof(threadCounts) / sizeof(threadCounts[0]); ++t)
+	{
+		const unsigned threads = threadCounts[t];
+		SharedPtr<WorkQueue> queue(new WorkQueue(context));
+		queue->CreateThreads(threads - 1);
+		batch->SetWorkQueue(queue);
+
+		timer.Reset();
+		batch->Raycast(physicsWorld, rays, rayResults);
+		const long long rayUSec = timer.GetUSec(true);
+		batch->Sweep(physicsWorld, sweeps, sweepResults);
+		const long long sweepUSec = timer.GetUSec(false);
+
+		// Every thread count must give the single-query answers
+		for (unsigned i = 0; i < numRays; ++i)
+		{
+			if (!Matches(rayResults[i], rayReference[i]))
+				++rayMismatches;
+		}
+		for (unsigned i = 0; i < numSweeps; ++i)
+		{
+			if (!Matches(sweepResults[i], sweepReference[i]))
+				++sweepMismatches;
+		}
+
+		const float rate = rayUSec > 0 ? numRays * 1000000.0f / rayUSec : 0.0f;
+		if (threads == 1)
+			singleThreadRate = rate;
+
+		String key = "threads" + String(threads);
+		report.Set(key + ".raysPerSec", rate);
+		report.Set(key + ".sweepsPerSec", sweepUSec > 0 ? numSweeps * 1000000.0f / sweepUSec : 0.0f);
+		report.Set(key + ".speedup", singleThreadRate > 0.0f ? rate / singleThreadRate : 0.0f);
+		report.Set(key + ".efficiency", singleThreadRate > 0.0f ? rate / singleThreadRate / threads : 0.0f);
+	}
+
+	report.Set("rayMismatches", rayMismatches);
+	report.Set("sweepMismatches", sweepMismatches);
+	if (rayMismatches || sweepMismatches)
+	{
+		URHO3D_LOGERRORF("Batched physics queries disagree with PhysicsWorld: %u rays, %u sweeps", rayMismatches,
+			sweepMismatches);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,147 @@
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Graphics/Material.h>
+#include <Urho3D/Graphics/Model.h>
+#include <Urho3D/Graphics/Octree.h>
+#include <Urho3D/Graphics/Terrain.h>
+#include <Urho3D/Math/Frustum.h>
+#include <Urho3D/Math/Sphere.h>
+#include <Urho3D/Resource/Image.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "../paged_terrain.h"
+#include "../terrain_scatter.h"
+#include "bench_suites.h"
+
+using namespace Urho3D;
+
+static const int SCATTER_BENCH_TERRAIN_SIZE = 1024;
+static const int SCATTER_BENCH_DENSITY_MAP_SIZE = 256;
+static const unsigned SCATTER_BENCH_FRUSTUMS = 64;
+
+// Build an image from a synthetic heightfield; 3 channels for a terrain heightmap, 1 (high byte) for a density map
+static SharedPtr<Image> CreateSyntheticImage(Context* context, int size, unsigned seed, bool heightMap)
+{
+	SyntheticTerrainSource source(IntVector2(size + 1, size + 1), seed);
+	PODVector<unsigned char> data;
+	source.ReadTile(0, 0, size, 1, data);
+
+	SharedPtr<Image> image(new Image(context));
+	if (heightMap)
+	{
+		image->SetSize(size + 1, size + 1, 3);
+		image->SetData(&data[0]);
+	}
+	else
+	{
+		PODVector<unsigned char> density((unsigned)((size + 1) * (size + 1)));
+		for (unsigned i = 0; i < density.Size(); ++i)
+			density[i] = data[i * 3];
+		image->SetSize(size + 1, size + 1, 1);
+		image->SetData(&density[0]);
+	}
+	return image;
+}
+
+bool RunScatterBenchmark(Context* context, BenchmarkReport& report)
+{
+	ResourceCache* cache = context->GetSubsystem<ResourceCache>();
+
+	SharedPtr<Scene> scene(new Scene(context));
+	scene->CreateComponent<Octree>(LOCAL);
+	Node* terrainNode = scene->CreateChild("Terrain", LOCAL);
+	Terrain* terrain = terrainNode->CreateComponent<Terrain>(LOCAL);
+	terrain->SetSpacing(Vector3(1.0f, 0.5f, 1.0f));
+	terrain->SetHeightMap(CreateSyntheticImage(context, SCATTER_BENCH_TERRAIN_SIZE, 1, true));
+	TerrainScatter* scatter = terrainNode->CreateComponent<TerrainScatter>(LOCAL);
+
+	SharedPtr<Image> densityMap = CreateSyntheticImage(context, SCATTER_BENCH_DENSITY_MAP_SIZE, 7, false);
+	float meanDensity = 0.0f;
+	for (int y = 0; y < densityMap->GetHeight(); ++y)
+	{
+		for (int x = 0; x < densityMap->GetWidth(); ++x)
+			meanDensity += densityMap->GetPixel(x, y).r_;
+	}
+	meanDensity /= densityMap->GetWidth() * densityMap->GetHeight();
+
+	ScatterLayer layer;
+	layer.model_ = cache->GetResource<Model>("Models/Mushroom.mdl");
+	layer.material_ = cache->GetResource<Material>("Materials/Mushroom.xml");
+	layer.densityMap_ = densityMap;
+	layer.minScale_ = 0.5f;
+	layer.maxScale_ = 1.5f;
+	if (!layer.model_)
+		return false;
+	const float radius = layer.model_->GetBoundingBox().HalfSize().Length();
+
+	// Fixed set of views spread over the terrain, looking outwards from its centre
+	Vector<Frustum> frustums;
+	for (unsigned i = 0; i < SCATTER_BENCH_FRUSTUMS; ++i)
+	{
+		float angle = i * 360.0f / SCATTER_BENCH_FRUSTUMS;
+		float distance = (i % 4 + 1) * SCATTER_BENCH_TERRAIN_SIZE * 0.1f;
+		Vector3 position(Cos(angle) * distance, 40.0f, Sin(angle) * distance);
+		Quaternion rotation(10.0f, angle * 1.7f, 0.0f);
+		Frustum frustum;
+		frustum.Define(60.0f, 16.0f / 9.0f, 1.0f, 0.1f, 500.0f, Matrix3x4(position, rotation, 1.0f));
+		frustums.Push(frustum);
+	}
+
+	const unsigned counts[] = { 10000, 100000, 1000000 };
+	const float area = (float)(SCATTER_BENCH_TERRAIN_SIZE * SCATTER_BENCH_TERRAIN_SIZE);
+	for (unsigned c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c)
+	{
+		String key = "n" + String(counts[c]);
+		layer.density_ = counts[c] / (area * meanDensity);
+		scatter->RemoveAllLayers();
+		scatter->AddLayer(layer);
+
+		HiresTimer timer;
+		scatter->Generate(false);
+		long long serialUSec = timer.GetUSec(true);
+		scatter->Generate(true);
+		long long parallelUSec = timer.GetUSec(false);
+
+		// Per-chunk culling through the component
+		PODVector<unsigned> visibleChunks;
+		unsigned visibleChunkTotal = 0;
+		timer.Reset();
+		for (unsigned f = 0; f < frustums.Size(); ++f)
+		{
+			scatter->CullChunks(frustums[f], visibleChunks);
+			visibleChunkTotal += visibleChunks.Size();
+		}
+		long long chunkCullUSec = timer.GetUSec(false);
+
+		// Reference: test every instance's bounding sphere, as one node per instance would
+		const Vector<ScatterChunk>& chunks = scatter->GetChunks();
+		unsigned visibleInstanceTotal = 0;
+		timer.Reset();
+		for (unsigned f = 0; f < frustums.Size(); ++f)
+		{
+			for (unsigned i = 0; i < chunks.Size(); ++i)
+			{
+				const ScatterInstances& instances = chunks[i].layers_[0];
+				for (unsigned j = 0; j < instances.positions_.Size(); ++j)
+				{
+					if (frustums[f].IsInsideFast(Sphere(instances.positions_[j], radius * instances.scales_[j])) != OUTSIDE)
+						++visibleInstanceTotal;
+				}
+			}
+		}
+		long long instanceCullUSec = timer.GetUSec(false);
+
+		report.Set(key + ".instances", scatter->GetNumInstances());
+		report.Set(key + ".chunks", chunks.Size());
+		report.Set(key + ".generateSerialMs", serialUSec / 1000.0f);
+		report.Set(key + ".generateParallelMs", parallelUSec / 1000.0f);
+		report.Set(key + ".chunkCullMsPerView", chunkCullUSec / 1000.0f / frustums.Size());
+		report.Set(key + ".instanceCullMsPerView", instanceCullUSec / 1000.0f / frustums.Size());
+		report.Set(key + ".visibleChunksPerView", (float)visibleChunkTotal / frustums.Size());
+		report.Set(key + ".visibleInstancesPerView", (float)visibleInstanceTotal / frustums.Size());
+	}
+
+	scatter->RemoveAllLayers();
+	return true;
+}
@@ -0,0 +1,110 @@
+#include <Urho3D/Container/Sort.h>
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "../scene_cache.h"
+#include "bench_suites.h"
+
+using namespace Urho3D;
+
+// Each load is repeated and the fastest run kept, to filter out scheduler noise
+static const unsigned SCENE_CACHE_BENCH_RUNS = 5;
+
+bool RunSceneCacheBenchmark(Context* context, BenchmarkReport& report)
+{
+	ResourceCache* cache = context->GetSubsystem<ResourceCache>();
+	FileSystem* fileSystem = context->GetSubsystem<FileSystem>();
+
+	// Private cache directory so the application's own snapshots are left alone
+	SharedPtr<SceneCache> sceneCache(new SceneCache(context));
+	sceneCache->SetDirectory(fileSystem->GetTemporaryDir() + "fpbench_scenecache");
+
+	// Every scene in every resource directory
+	Vector<String> sceneNames;
+	const Vector<String>& resourceDirs = cache->GetResourceDirs();
+	for (unsigned i = 0; i < resourceDirs.Size(); ++i)
+	{
+		Vector<String> files;
+		fileSystem->ScanDir(files, resourceDirs[i] + "Scenes/", "*.xml", SCAN_FILES, false);
+		for (unsigned j = 0; j < files.Size(); ++j)
+		{
+			if (!sceneNames.Contains("Scenes/" + files[j]))
+				sceneNames.Push("Scenes/" + files[j]);
+		}
+	}
+	Sort(sceneNames.Begin(), sceneNames.End());
+
+	float totalCold = 0.0f;
+	float totalWarm = 0.0f;
+	unsigned measured = 0;
+	for (unsigned i = 0; i < sceneNames.Size(); ++i)
+	{
+		const String& name = sceneNames[i];
+		String key = "scenes." + GetFileName(name);
+		SharedPtr<Scene> scene(new Scene(context));
+		SharedPtr<File> file = cache->GetFile(name);
+		// Loads the scene's resources, which both timed paths then share
+		if (!file || !scene->LoadXML(*file))
+		{
+			URHO3D_LOGWARNING("Skipping scene " + name + " which failed to load");
+			continue;
+		}
+
+		long long cold = M_MAX_INT;
+		for (unsigned run = 0; run < SCENE_CACHE_BENCH_RUNS; ++run)
+		{
+			file->Seek(0);
+			scene = new Scene(context);
+			HiresTimer timer;
+			scene->LoadXML(*file);
+			cold = Min(cold, timer.GetUSec(false));
+		}
+
+		HiresTimer buildTimer;
+		sceneCache->SaveSnapshot(scene, name);
+		long long build = buildTimer.GetUSec(false);
+
+		long long warm = M_MAX_INT;
+		for (unsigned run = 0; run < SCENE_CACHE_BENCH_RUNS; ++run)
+		{
+			scene = new Scene(context);
+			HiresTimer timer;
+			if (!sceneCache->LoadSnapshot(scene, name))
+			{
+				warm = 0;
+				break;
+			}
+			warm = Min(warm, timer.GetUSec(false));
+		}
+		if (!warm)
+		{
+			URHO3D_LOGWARNING("Snapshot of " + name + " could not be loaded back");
+			continue;
+		}
+
+		File snapshot(context, sceneCache->GetSnapshotName(name));
+		report.Set(key + ".xmlBytes", file->GetSize());
+		report.Set(key + ".snapshotBytes", snapshot.GetSize());
+		report.Set(key + ".coldMs", cold / 1000.0f);
+		report.Set(key + ".buildMs", build / 1000.0f);
+		report.Set(key + ".warmMs", warm / 1000.0f);
+		report.Set(key + ".speedup", (float)cold / warm);
+		snapshot.Close();
+		sceneCache->RemoveSnapshot(name);
+
+		totalCold += cold / 1000.0f;
+		totalWarm += warm / 1000.0f;
+		++measured;
+	}
+
+	report.Set("scenes", measured);
+	report.Set("totalColdMs", totalCold);
+	report.Set("totalWarmMs", totalWarm);
+	report.Set("totalSpeedup", totalWarm > 0.0f ? totalCold / totalWarm : 0.0f);
+	return measured > 0;
+}
@@ -0,0 +1,131 @@
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Engine/Engine.h>
+#include <Urho3D/Graphics/Octree.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Math/Random.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "../bot_clients.h"
+#include "../dedicated_server.h"
+#include "bench_suites.h"
+
+using namespace Urho3D;
+
+static const BoundingBox SERVER_BENCH_BOUNDS(Vector3(-500.0f, 0.0f, -500.0f), Vector3(500.0f, 0.0f, 500.0f));
+// Longest wait for a step's bots to connect and receive the scene
+static const long long SERVER_BENCH_CONNECT_TIMEOUT = 30000000;
+// Time after connecting before measuring, so the initial scene transfer is out of the way
+static const long long SERVER_BENCH_SETTLE_TIME = 2000000;
+
+// Run real-time engine frames for a duration, or until at least connected bots have received the scene
+static void RunFrames(Engine* engine, long long durationUSec, const BotClients* bots = 0, unsigned connected = 0)
+{
+	HiresTimer timer;
+	while (timer.GetUSec(false) < durationUSec && !engine->IsExiting())
+	{
+		if (bots && bots->GetNumConnected() >= connected)
+			break;
+		engine->RunFrame();
+	}
+}
+
+bool RunServerBenchmark(Context* context, BenchmarkReport& report)
+{
+	const unsigned maxClients = Max(ToUInt(GetArgumentValue("clients", "200")), 1U);
+	const unsigned numAgents = ToUInt(GetArgumentValue("agents", "2000"));
+	const int tickRate = Max(ToInt(GetArgumentValue("tickrate", "30")), 1);
+	const float interestRadius = ToFloat(GetArgumentValue("interest", "100"));
+	const unsigned short port = (unsigned short)ToUInt(GetArgumentValue("port", "2346"));
+	const long long measureUSec = (long long)(ToFloat(GetArgumentValue("seconds", "5")) * 1000000.0f);
+	SetRandomSeed(1);
+
+	// Network traffic needs real time to pass, so frames are paced by the frame limiter instead of a fixed step
+	Engine* engine = context->GetSubsystem<Engine>();
+	engine->SetMaxFps(60);
+
+	SharedPtr<Scene> scene(new Scene(context));
+	scene->CreateComponent<Octree>(REPLICATED);
+	SharedPtr<DedicatedServer> server(new DedicatedServer(context));
+	server->SetTickRate(tickRate);
+	server->SetInterestRadius(interestRadius);
+	if (!server->Start(scene, port))
+		return false;
+	server->SpawnAgents(numAgents, SERVER_BENCH_BOUNDS);
+
+	SharedPtr<BotClients> bots(new BotClients(context));
+	bots->SetServer("127.0.0.1", port);
+	bots->SetBounds(SERVER_BENCH_BOUNDS);
+	bots->SetTickRate(tickRate);
+
+	report.Set("agents", numAgents);
+	report.Set("tickRate", tickRate);
+	report.Set("interestRadius", interestRadius);
+
+	// Client counts double up to the maximum
+	PODVector<unsigned> steps;
+	for (unsigned clients = 1; clients < maxClients; clients *= 2)
+		steps.Push(clients);
+	steps.Push(maxClients);
+
+	bool success = true;
+	float singleClientServerCpu = 0.0f;
+	for (unsigned i = 0; i < steps.Size(); ++i)
+	{
+		const unsigned clients = steps[i];
+		bots->AddBots(clients - bots->GetNumBots());
+		RunFrames(engine, SERVER_BENCH_CONNECT_TIMEOUT, bots, clients);
+		const unsigned connected = bots->GetNumConnected();
+		if (connected < clients)
+		{
+			URHO3D_LOGERRORF("Only %u of %u bots connected", connected, clients);
+			success = false;
+		}
+		RunFrames(engine, SERVER_BENCH_SETTLE_TIME);
+
+		server->ResetStats();
+		long long cpuStart = GetProcessCpuTimeUSec();
+		HiresTimer wallTimer;
+		RunFrames(engine, measureUSec);
+		long long wallUSec = wallTimer.GetUSec(false);
+		long long cpuUSec = GetProcessCpuTimeUSec() - cpuStart;
+
+		PODVector<float> ticks = server->GetTickTimes();
+		PODVector<float> updates = server->GetUpdateTimes();
+		TimingStats tickStats = ComputeTimingStats(ticks);
+		TimingStats updateStats = ComputeTimingStats(updates);
+		// The bots run in this process on the same thread, so process CPU includes their work. The server's own
+		// share is the time spent in its scene updates and network ticks, which is what the scaling is judged on
+		const float serverMs = tickStats.mean_ * tickStats.count_ + updateStats.mean_ * updateStats.count_;
+		const float serverCpuPercent = wallUSec > 0 ? 100000.0f * serverMs / wallUSec : 0.0f;
+		const float processCpuPercent = wallUSec > 0 ? 100.0f * cpuUSec / wallUSec : 0.0f;
+		if (i == 0)
+			singleClientServerCpu = serverCpuPercent;
+
+		String key = "clients" + String(clients);
+		report.Set(key + ".connected", connected);
+		report.Set(key + ".tickMs", tickStats);
+		report.Set(key + ".ticksPerSec", wallUSec > 0 ? tickStats.count_ * 1000000.0f / wallUSec : 0.0f);
+		report.Set(key + ".bytesOutPerClientPerSec", server->GetBytesOutPerClient());
+		report.Set(key + ".bytesInPerBotPerSec", bots->GetBytesInPerBot());
+		// What the bots hold against what is in their radius; the difference is the replicated parents and any
+		// nodes that interest management failed to keep out
+		const float relevantNodes = server->GetRelevantNodesPerClient();
+		const float replicatedNodes = bots->GetReplicatedNodesPerBot();
+		report.Set(key + ".relevantNodesPerClient", relevantNodes);
+		report.Set(key + ".replicaNodesPerClient", server->GetReplicatedNodesPerClient());
+		report.Set(key + ".replicatedNodesPerBot", replicatedNodes);
+		report.Set(key + ".replicatedToRelevant", relevantNodes > 0.0f ? replicatedNodes / relevantNodes : 0.0f);
+		report.Set(key + ".updateMs", updateStats);
+		report.Set(key + ".serverCpuPercent", serverCpuPercent);
+		report.Set(key + ".cpuRelativeToOneClient", singleClientServerCpu > 0.0f ?
+			serverCpuPercent / singleClientServerCpu : 0.0f);
+		report.Set(key + ".processCpuPercentWithBots", processCpuPercent);
+		report.Set(key + ".memoryKB", GetProcessMemoryKB(false));
+	}
+
+	bots->RemoveAllBots();
+	server->Stop();
+	engine->SetMaxFps(0);
+	return success;
+}
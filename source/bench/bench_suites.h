@@ -0,0 +1,56 @@
+#ifndef BENCH_SUITES_H
+#define BENCH_SUITES_H
+
+#include "benchmark_report.h"
+
+namespace Urho3D
+{
+	class Context;
+}
+
+// Each suite fills in the report and returns false if the run failed or missed its target.
+
+/// Telemetry ring overhead: cost per Record() with recording enabled and disabled, drain cost, and drops while a
+/// background writer is draining to disk. Fails if Record() costs more than -maxrecordns <ns> (default 100) with
+/// recording enabled or -maxdisabledns <ns> (default 10) with it disabled; 0 turns a check off.
+bool RunTelemetryBenchmark(Context* context, BenchmarkReport& report);
+
+/// XML versus binary snapshot load time for every scene in Scenes/. Cold is the XML parse, warm the memory-mapped
+/// snapshot; resources are loaded once beforehand so only scene parsing and instantiation are compared.
+bool RunSceneCacheBenchmark(Context* context, BenchmarkReport& report);
+
+/// Paged terrain streaming: flies diagonally across a synthetic 16k x 16k heightfield at a fixed timestep, running
+/// real engine frames, and reports frame-time percentiles, frames over the target frame time, and resident memory.
+/// Fails on frames over the target, on more tile nodes or pending reads than the view holds, or on RSS growing more
+/// than a limit after the first quarter of the flight. Options: -frames <n> (default 3000), -maxframe <ms>
+/// (default 16.7), -maxrssgrowthkb <KB> (default 16384, 0 turns the check off).
+bool RunTerrainBenchmark(Context* context, BenchmarkReport& report);
+
+/// Prop scattering at 10k, 100k and 1M instances on a 1k x 1k terrain: generation time on one thread and on the
+/// WorkQueue, and culling time per frustum with per-chunk bounds versus testing every instance.
+bool RunScatterBenchmark(Context* context, BenchmarkReport& report);
+
+/// Data-oriented agent update on 1, 2, 4 and 8 threads: agents simulated per millisecond, speedup over one thread,
+/// and the cost of the single-threaded write-back to scene nodes. Options: -agents <n> (default 50000),
+/// -batchsize <n> (default 1024).
+bool RunAgentBenchmark(Context* context, BenchmarkReport& report);
+
+/// Batched physics queries against a heightfield terrain with static obstacles: rays and sphere/box sweeps per
+/// second on 1, 2, 4 and 8 threads, against one PhysicsWorld query at a time. Fails if any batched result differs
+/// from the single-query answer. Options: -queries <n> rays (default 100000, a tenth as many sweeps),
+/// -batchsize <n> (default 256).
+bool RunPhysicsBenchmark(Context* context, BenchmarkReport& report);
+
+/// Resource package for TestScene.xml against loose files: disk footprint, and scene load time including all
+/// resources, cold (files dropped from the OS page cache first, where supported) and warm.
+bool RunPackageBenchmark(Context* context, BenchmarkReport& report);
+
+/// Loopback load test of the dedicated server: bot clients in steps doubling up to -clients <n> (default 200)
+/// against a server with -agents <n> (default 2000) replicated agents. Per step: server tick time, bytes sent per
+/// client, nodes in each client's interest radius against nodes each bot actually holds, and server CPU use: the
+/// time in the server's scene updates and network ticks, without the bots that share the process. Fails if any bot
+/// does not connect. Options: -tickrate <n> (default 30), -interest <r> (default 100), -port <n> (default 2346),
+/// -seconds <s> measured per step (default 5).
+bool RunServerBenchmark(Context* context, BenchmarkReport& report);
+
+#endif
@@ -0,0 +1,95 @@
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/Log.h>
+
+#include "../telemetry.h"
+#include "bench_suites.h"
+
+using namespace Urho3D;
+
+static const unsigned TELEMETRY_BENCH_SAMPLES = 1 << 20;
+// Default per-event budgets in nanoseconds; generous for one push into a lock-free ring, tight enough to catch a lock
+// or an allocation creeping into Record()
+static const char* TELEMETRY_BENCH_MAX_RECORD_NS = "100";
+static const char* TELEMETRY_BENCH_MAX_DISABLED_NS = "10";
+
+bool RunTelemetryBenchmark(Context* context, BenchmarkReport& report)
+{
+	// A private instance so the application's own telemetry stream is not disturbed
+	Telemetry telemetry(context);
+	const unsigned batch = telemetry.GetRing().GetCapacity() / 2;
+	TelemetrySample sample;
+	HiresTimer timer;
+
+	// Record and drain in half-ring batches so the ring never fills and every Record() takes the normal path
+	telemetry.SetEnabled(true);
+	long long recordUSec = 0;
+	long long popUSec = 0;
+	unsigned recorded = 0;
+	while (recorded < TELEMETRY_BENCH_SAMPLES)
+	{
+		timer.Reset();
+		for (unsigned i = 0; i < batch; ++i)
+			telemetry.Record("bench.sample", (float)i);
+		recordUSec += timer.GetUSec(false);
+
+		timer.Reset();
+		while (telemetry.Pop(sample))
+			;
+		popUSec += timer.GetUSec(false);
+		recorded += batch;
+	}
+
+	// Cost left behind when recording is switched off
+	telemetry.SetEnabled(false);
+	timer.Reset();
+	for (unsigned i = 0; i < recorded; ++i)
+		telemetry.Record("bench.sample", (float)i);
+	long long disabledUSec = timer.GetUSec(false);
+
+	// Full path with the drain thread writing to disk; an unpaced producer shows the worst case for drops
+	FileSystem* fileSystem = context->GetSubsystem<FileSystem>();
+	String fileName = fileSystem->GetTemporaryDir() + "fpbench_telemetry_overhead.bin";
+	long long writerUSec = 0;
+	unsigned dropped = 0;
+	if (telemetry.Open(fileName))
+	{
+		timer.Reset();
+		for (unsigned i = 0; i < recorded; ++i)
+			telemetry.Record("bench.sample", (float)i);
+		writerUSec = timer.GetUSec(false);
+		dropped = telemetry.GetDropped();
+		telemetry.Close();
+		fileSystem->Delete(fileName);
+	}
+
+	report.Set("samples", recorded);
+	report.Set("ringCapacity", telemetry.GetRing().GetCapacity());
+	report.Set("ringBytes", telemetry.GetRing().GetMemoryUse());
+	report.Set("recordNs", recordUSec * 1000.0f / recorded);
+	report.Set("popNs", popUSec * 1000.0f / recorded);
+	report.Set("disabledRecordNs", disabledUSec * 1000.0f / recorded);
+	report.Set("recordWithWriterNs", writerUSec * 1000.0f / recorded);
+	report.Set("droppedWithWriter", dropped);
+
+	// Overhead must stay bounded: a regression past the budget fails the run
+	const float recordNs = recordUSec * 1000.0f / recorded;
+	const float disabledNs = disabledUSec * 1000.0f / recorded;
+	const float maxRecordNs = ToFloat(GetArgumentValue("maxrecordns", TELEMETRY_BENCH_MAX_RECORD_NS));
+	const float maxDisabledNs = ToFloat(GetArgumentValue("maxdisabledns", TELEMETRY_BENCH_MAX_DISABLED_NS));
+	report.Set("maxRecordNs", maxRecordNs);
+	report.Set("maxDisabledRecordNs", maxDisabledNs);
+	bool passed = true;
+	if (maxRecordNs > 0.0f && recordNs > maxRecordNs)
+	{
+		URHO3D_LOGERRORF("Telemetry Record() costs %.1f ns, over the %.1f ns budget", recordNs, maxRecordNs);
+		passed = false;
+	}
+	if (maxDisabledNs > 0.0f && disabledNs > maxDisabledNs)
+	{
+		URHO3D_LOGERRORF("Disabled telemetry Record() costs %.1f ns, over the %.1f ns budget", disabledNs, maxDisabledNs);
+		passed = false;
+	}
+	return passed;
+}
@@ -0,0 +1,137 @@
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Engine/Engine.h>
+#include <Urho3D/Graphics/Octree.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "../paged_terrain.h"
+#include "bench_suites.h"
+
+using namespace Urho3D;
+
+// 16k x 16k quads
+static const int TERRAIN_BENCH_WORLD_SIZE = 16385;
+// Cap on frames spent filling the view before measuring starts
+static const unsigned TERRAIN_BENCH_MAX_FILL_FRAMES = 10000;
+// Default allowed RSS growth after the first quarter of the flight. Tile memory is recycled once the view is full, so
+// steady growth past allocator noise means tiles or their reads are leaking
+static const char* TERRAIN_BENCH_MAX_RSS_GROWTH_KB = "16384";
+
+bool RunTerrainBenchmark(Context* context, BenchmarkReport& report)
+{
+	const unsigned frames = Max(ToUInt(GetArgumentValue("frames", "3000")), 1U);
+	const float maxFrameMs = ToFloat(GetArgumentValue("maxframe", "16.7"));
+	const unsigned maxRssGrowthKB = ToUInt(GetArgumentValue("maxrssgrowthkb", TERRAIN_BENCH_MAX_RSS_GROWTH_KB));
+	const float timeStep = 1.0f / 60.0f;
+	Engine* engine = context->GetSubsystem<Engine>();
+	engine->SetMaxFps(0);
+
+	const unsigned baselineKB = GetProcessMemoryKB(false);
+
+	SharedPtr<Scene> scene(new Scene(context));
+	scene->CreateComponent<Octree>(LOCAL);
+	Node* cameraNode = scene->CreateChild("Camera", LOCAL);
+	Node* terrainNode = scene->CreateChild("PagedTerrain", LOCAL);
+	PagedTerrain* terrain = terrainNode->CreateComponent<PagedTerrain>(LOCAL);
+	terrain->SetSource(new SyntheticTerrainSource(IntVector2(TERRAIN_BENCH_WORLD_SIZE, TERRAIN_BENCH_WORLD_SIZE)));
+	terrain->SetSpacing(Vector3(1.0f, 1.0f, 1.0f));
+	terrain->SetFocusNode(cameraNode);
+
+	// Diagonal flight from one corner region to the opposite one
+	const float halfExtent = (TERRAIN_BENCH_WORLD_SIZE - 1) * 0.45f;
+	const Vector3 start(-halfExtent, 300.0f, -halfExtent);
+	const Vector3 end(halfExtent, 300.0f, halfExtent);
+
+	// Let the initial view fill before measuring; its duration is reported separately
+	cameraNode->SetPosition(start);
+	HiresTimer fillTimer;
+	unsigned fillFrames = 0;
+	do
+	{
+		engine->SetNextTimeStep(timeStep);
+		engine->RunFrame();
+		++fillFrames;
+	}
+	while ((terrain->GetNumPendingTiles() || !terrain->GetNumResidentTiles()) &&
+		fillFrames < TERRAIN_BENCH_MAX_FILL_FRAMES);
+	const float fillMs = fillTimer.GetUSec(false) / 1000.0f;
+
+	PODVector<float> frameTimes;
+	frameTimes.Reserve(frames);
+	unsigned hitches = 0;
+	unsigned maxResident = 0;
+	unsigned maxTileNodes = 0;
+	unsigned maxPending = 0;
+	unsigned warmupKB = 0;
+	unsigned midwayKB = 0;
+	HiresTimer frameTimer;
+	for (unsigned frame = 0; frame < frames; ++frame)
+	{
+		cameraNode->SetPosition(start.Lerp(end, (float)frame / frames));
+		engine->SetNextTimeStep(timeStep);
+		frameTimer.Reset();
+		engine->RunFrame();
+		float frameMs = frameTimer.GetUSec(false) / 1000.0f;
+
+		frameTimes.Push(frameMs);
+		if (frameMs > maxFrameMs)
+			++hitches;
+		maxResident = Max(maxResident, terrain->GetNumResidentTiles());
+		// Tile nodes actually in the scene, which would also count tiles the component lost track of
+		maxTileNodes = Max(maxTileNodes, terrainNode->GetNumChildren());
+		maxPending = Max(maxPending, terrain->GetNumPendingTiles());
+		if (frame == frames / 4)
+			warmupKB = GetProcessMemoryKB(false);
+		if (frame == frames / 2)
+			midwayKB = GetProcessMemoryKB(false);
+	}
+
+	const unsigned finalKB = GetProcessMemoryKB(false);
+	const unsigned rssGrowthKB = finalKB > warmupKB ? finalKB - warmupKB : 0;
+	const unsigned viewTiles = (unsigned)((2 * terrain->GetViewRadius() + 1) * (2 * terrain->GetViewRadius() + 1));
+	report.Set("worldSize", TERRAIN_BENCH_WORLD_SIZE);
+	report.Set("tileSize", terrain->GetTileSize());
+	report.Set("viewRadiusTiles", terrain->GetViewRadius());
+	report.Set("frames", frames);
+	report.Set("timeStep", timeStep);
+	report.Set("initialFillMs", fillMs);
+	report.Set("initialFillFrames", fillFrames);
+	report.Set("frameMs", ComputeTimingStats(frameTimes));
+	report.Set("targetFrameMs", maxFrameMs);
+	report.Set("framesOverTarget", hitches);
+	report.Set("tilesBuilt", terrain->GetNumTilesBuilt());
+	report.Set("tilesUnloaded", terrain->GetNumTilesUnloaded());
+	report.Set("maxResidentTiles", maxResident);
+	report.Set("maxTileNodes", maxTileNodes);
+	report.Set("maxPendingTiles", maxPending);
+	report.Set("viewTiles", viewTiles);
+	report.Set("baselineRssKB", baselineKB);
+	report.Set("warmupRssKB", warmupKB);
+	report.Set("midwayRssKB", midwayKB);
+	report.Set("finalRssKB", finalKB);
+	report.Set("peakRssKB", GetProcessMemoryKB(true));
+	report.Set("rssGrowthKB", rssGrowthKB);
+	report.Set("maxRssGrowthKB", maxRssGrowthKB);
+
+	bool passed = true;
+	if (hitches)
+	{
+		URHO3D_LOGWARNINGF("Terrain benchmark: %u of %u frames over %.2f ms", hitches, frames, maxFrameMs);
+		passed = false;
+	}
+	// Geometry and reads in flight are both bounded by the view
+	if (maxTileNodes > viewTiles || maxPending > viewTiles)
+	{
+		URHO3D_LOGERRORF("Terrain benchmark: up to %u tile nodes and %u pending reads for a %u tile view", maxTileNodes,
+			maxPending, viewTiles);
+		passed = false;
+	}
+	if (maxRssGrowthKB && rssGrowthKB > maxRssGrowthKB)
+	{
+		URHO3D_LOGERRORF("Terrain benchmark: RSS grew %u KB after warm-up, over the %u KB limit", rssGrowthKB,
+			maxRssGrowthKB);
+		passed = false;
+	}
+	return passed;
+}
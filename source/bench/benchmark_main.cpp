@@ -0,0 +1,208 @@
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Core/ProcessUtils.h>
+#include <Urho3D/Core/StringUtils.h>
+#include <Urho3D/Engine/Application.h>
+#include <Urho3D/Engine/Engine.h>
+#include <Urho3D/Engine/EngineDefs.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "../main.h"
+#include "benchmark_main.h"
+#include "bench_suites.h"
+
+using namespace Urho3D;
+
+// Macro to start the application.
+URHO3D_DEFINE_APPLICATION_MAIN(FirstAppBenchmark)
+
+FirstAppBenchmark::FirstAppBenchmark(Context* context) :
+	FirstApp(context),
+	frames_(600),
+	warmupFrames_(30),
+	timeStep_(1.0f / 60.0f),
+	maxP99_(0.0f),
+	suitePassed_(true),
+	frameNumber_(0),
+	updateTime_(0.0f)
+{
+}
+
+void FirstAppBenchmark::Setup()
+{
+	FirstApp::Setup();
+
+	// No window and no GPU: the run measures CPU-side frame cost only
+	engineParameters_[EP_HEADLESS] = true;
+	engineParameters_[EP_FULL_SCREEN] = false;
+	engineParameters_[EP_LOG_NAME] = "fpbench.log";
+	// Runs are bounded, so telemetry is on unless another file is given
+	telemetryFile_ = GetArgumentValue("telemetry", "fpbench_telemetry.bin");
+	// Packages are built by fpbin; the package suite builds its own. Likewise the server suite runs its own server
+	// and bots
+	buildPackage_ = false;
+	serverMode_ = false;
+	numBots_ = 0;
+	// The flythrough path is deterministic; ground queries would only add unmeasured physics work to the frames
+	clampCameraToGround_ = false;
+
+	benchmark_ = GetArgumentValue("bench", "flythrough").ToLower();
+	frames_ = ToUInt(GetArgumentValue("frames", "600"));
+	warmupFrames_ = ToUInt(GetArgumentValue("warmup", "30"));
+	timeStep_ = ToFloat(GetArgumentValue("timestep", String(1.0f / 60.0f)));
+	reportName_ = GetArgumentValue("report", "fpbench.json");
+	maxP99_ = ToFloat(GetArgumentValue("maxp99", "0"));
+	loadTimeBudgetMs_ = ToInt(GetArgumentValue("loadbudget", String(loadTimeBudgetMs_)));
+	asyncLoading_ = !HasArgument("syncload");
+	useSceneCache_ = !HasArgument("noscenecache");
+
+	if (!frames_)
+		frames_ = 1;
+	if (timeStep_ <= 0.0f)
+		timeStep_ = 1.0f / 60.0f;
+	frameTimes_.Reserve(frames_);
+	updateTimes_.Reserve(frames_);
+}
+
+void FirstAppBenchmark::Start()
+{
+	FirstApp::Start();
+
+	report_.Set("benchmark", benchmark_);
+	if (benchmark_ != "flythrough")
+	{
+		// Self-contained suites run synchronously and exit without running the main loop
+		// The main scene is not part of these measurements
+		scene_->SetUpdateEnabled(false);
+		HiresTimer suiteTimer;
+		bool success = false;
+		if (benchmark_ == "telemetry")
+			success = RunTelemetryBenchmark(context_, report_);
+		else if (benchmark_ == "scenecache")
+			success = RunSceneCacheBenchmark(context_, report_);
+		else if (benchmark_ == "terrain")
+			success = RunTerrainBenchmark(context_, report_);
+		else if (benchmark_ == "scatter")
+			success = RunScatterBenchmark(context_, report_);
+		else if (benchmark_ == "agents")
+			success = RunAgentBenchmark(context_, report_);
+		else if (benchmark_ == "physics")
+			success = RunPhysicsBenchmark(context_, report_);
+		else if (benchmark_ == "package")
+			success = RunPackageBenchmark(context_, report_);
+		else if (benchmark_ == "server")
+			success = RunServerBenchmark(context_, report_);
+		else
+			URHO3D_LOGERROR("Unknown benchmark " + benchmark_);
+		report_.Set("suiteMs", suiteTimer.GetUSec(false) / 1000.0f);
+		report_.Set("passed", success ? 1U : 0U);
+		// Applied in Stop(), as a nonzero exit code here would skip the main loop and Stop() with it
+		suitePassed_ = success;
+		engine_->Exit();
+		return;
+	}
+
+	// Run as fast as possible and feed a fixed timestep so runs are comparable between machines and builds
+	engine_->SetMaxFps(0);
+	engine_->SetNextTimeStep(timeStep_);
+	UpdateCamera();
+
+	SubscribeToEvent(E_BEGINFRAME, URHO3D_HANDLER(FirstAppBenchmark, HandleBeginFrame));
+	SubscribeToEvent(E_POSTRENDERUPDATE, URHO3D_HANDLER(FirstAppBenchmark, HandlePostRenderUpdate));
+	// E_ENDFRAME is already subscribed by FirstApp and reaches the HandleEndFrame override
+
+	URHO3D_LOGINFOF("Benchmark: %u frames (+%u warmup) at %.4f s timestep", frames_, warmupFrames_, timeStep_);
+}
+
+void FirstAppBenchmark::Stop()
+{
+	TimingStats frameStats;
+	if (benchmark_ == "flythrough")
+	{
+		report_.Set("scene", String("Scenes/TestScene.xml"));
+		report_.Set("frames", (unsigned)frameTimes_.Size());
+		report_.Set("warmupFrames", warmupFrames_);
+		report_.Set("timeStep", timeStep_);
+		const SceneLoadStats& loadStats = sceneLoader_->GetStats();
+		report_.Set("sceneLoadMode", String(loadStats.async_ ? "async" : "sync"));
+		report_.Set("sceneLoadSource", String(loadStats.snapshot_ ? "snapshot" : "xml"));
+		report_.Set("sceneLoadMs", sceneLoadTime_ / 1000.0f);
+		report_.Set("sceneLoadMainThreadMs", loadStats.mainThreadTime_ / 1000.0f);
+		report_.Set("sceneLoadLongestSliceMs", loadStats.longestFrame_ / 1000.0f);
+		report_.Set("sceneLoadFrames", loadStats.frames_);
+		report_.Set("sceneLoadResources", loadStats.resources_);
+		report_.Set("timeToFirstFrameMs", timeToFirstFrame_ / 1000.0f);
+		frameStats = ComputeTimingStats(frameTimes_);
+		report_.Set("frameMs", frameStats);
+		report_.Set("updateMs", ComputeTimingStats(updateTimes_));
+	}
+
+	if (report_.Save(context_, reportName_))
+		URHO3D_LOGINFO("Benchmark report written to " + reportName_);
+	else
+		URHO3D_LOGERROR("Could not write benchmark report " + reportName_);
+
+	if (maxP99_ > 0.0f && frameStats.p99_ > maxP99_)
+	{
+		URHO3D_LOGERRORF("p99 frame time %.3f ms exceeds budget of %.3f ms", frameStats.p99_, maxP99_);
+		exitCode_ = EXIT_FAILURE;
+	}
+	if (!suitePassed_)
+		exitCode_ = EXIT_FAILURE;
+
+	FirstApp::Stop();
+}
+
+void FirstAppBenchmark::UpdateCamera()
+{
+	if (!cameraNode_)
+		return;
+
+	// Deterministic path that depends only on the frame number: an orbit around the terrain centre with a
+	// slow vertical bob, always looking at the centre
+	float t = frameNumber_ * timeStep_;
+	float angle = t * 20.0f;
+	Vector3 position(Cos(angle) * 60.0f, 15.0f + 5.0f * Sin(angle * 3.0f), Sin(angle) * 60.0f);
+	cameraNode_->SetPosition(position);
+	cameraNode_->LookAt(Vector3::ZERO);
+}
+
+void FirstAppBenchmark::HandleBeginFrame(StringHash eventType, VariantMap& eventData)
+{
+	frameTimer_.Reset();
+	UpdateCamera();
+}
+
+void FirstAppBenchmark::HandlePostRenderUpdate(StringHash eventType, VariantMap& eventData)
+{
+	updateTime_ = frameTimer_.GetUSec(false) / 1000.0f;
+}
+
+void FirstAppBenchmark::HandleEndFrame(StringHash eventType, VariantMap& eventData)
+{
+	FirstApp::HandleEndFrame(eventType, eventData);
+
+	// Suites that run their own frames measure those themselves
+	if (benchmark_ != "flythrough")
+		return;
+
+	// Measuring starts once the scene is complete
+	if (sceneLoader_->IsLoading())
+	{
+		engine_->SetNextTimeStep(timeStep_);
+		return;
+	}
+
+	float frameTime = frameTimer_.GetUSec(false) / 1000.0f;
+	if (frameNumber_ >= warmupFrames_)
+	{
+		frameTimes_.Push(frameTime);
+		updateTimes_.Push(updateTime_);
+	}
+
+	++frameNumber_;
+	if (frameNumber_ >= warmupFrames_ + frames_)
+		engine_->Exit();
+	else
+		engine_->SetNextTimeStep(timeStep_);
+}
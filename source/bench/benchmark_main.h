@@ -0,0 +1,76 @@
+#ifndef BENCHMARK_MAIN_H
+#define BENCHMARK_MAIN_H
+
+#include <Urho3D/Core/Timer.h>
+
+#include "benchmark_report.h"
+
+/// Headless benchmark driver (fpbench target). By default loads the same scene as fpbin, flies cameraNode_ along a
+/// deterministic path at a fixed timestep for a fixed number of frames and writes a JSON report on exit. Other
+/// suites (see bench_suites.h) run to completion inside Start() and write their results to the same report.
+///
+/// Command line (in addition to the usual engine parameters):
+///   -bench <name>   suite to run: flythrough (default), telemetry, scenecache, terrain,
+///                   scatter, agents, physics, package, server
+///   -frames <n>     measured frames (default 600)
+///   -warmup <n>     frames run before measuring starts (default 30)
+///   -timestep <s>   fixed simulation timestep in seconds (default 1/60)
+///   -report <file>  report path (default fpbench.json)
+///   -maxp99 <ms>    exit with failure if the p99 frame time exceeds this budget
+///   -syncload       load the scene synchronously instead of in the background
+///   -loadbudget <ms> per-frame time budget for async scene loading (default 5)
+///   -noscenecache   always load the scene from XML
+///   -telemetry <file> telemetry output file (default fpbench_telemetry.bin)
+///   -usepackage     load resources from the resource package built by "fpbin -package"
+class FirstAppBenchmark : public FirstApp
+{
+	URHO3D_OBJECT(FirstAppBenchmark, FirstApp);
+
+public:
+	/// Construct.
+	FirstAppBenchmark(Context* context);
+
+	virtual void Setup();
+	virtual void Start();
+	virtual void Stop();
+
+private:
+	// Name of the suite being run
+	String benchmark_;
+	// Results, written out in Stop()
+	BenchmarkReport report_;
+	// Measured frame count
+	unsigned frames_;
+	// Frames run before measuring
+	unsigned warmupFrames_;
+	// Fixed timestep fed to the engine every frame
+	float timeStep_;
+	// Report file name
+	String reportName_;
+	// p99 frame time budget in milliseconds, zero for none
+	float maxP99_;
+	// Result of a self-contained suite
+	bool suitePassed_;
+
+	// Frames run so far, including warmup
+	unsigned frameNumber_;
+	// Timer reset at the start of every frame
+	HiresTimer frameTimer_;
+	// Per-frame samples in milliseconds
+	PODVector<float> frameTimes_;
+	PODVector<float> updateTimes_;
+	// Update time of the current frame in milliseconds
+	float updateTime_;
+
+	// Place the camera on the flythrough path for the current frame
+	void UpdateCamera();
+
+	// Handle frame begin
+	void HandleBeginFrame(StringHash eventType, VariantMap& eventData);
+	// Handle end of the update phase
+	void HandlePostRenderUpdate(StringHash eventType, VariantMap& eventData);
+	// Handle frame end
+	virtual void HandleEndFrame(StringHash eventType, VariantMap& eventData);
+};
+
+#endif
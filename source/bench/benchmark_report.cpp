@@ -0,0 +1,143 @@
+#include <cstdio>
+#include <cstring>
+
+#include <Urho3D/Container/Sort.h>
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/StringUtils.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/Math/MathDefs.h>
+
+#include "benchmark_report.h"
+
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+
+unsigned GetProcessMemoryKB(bool peak)
+{
+	unsigned kilobytes = 0;
+#ifdef __linux__
+	FILE* status = fopen("/proc/self/status", "r");
+	if (!status)
+		return 0;
+	const char* field = peak ? "VmHWM:" : "VmRSS:";
+	char line[256];
+	while (fgets(line, sizeof(line), status))
+	{
+		if (!strncmp(line, field, strlen(field)))
+		{
+			sscanf(line + strlen(field), "%u", &kilobytes);
+			break;
+		}
+	}
+	fclose(status);
+#endif
+	return kilobytes;
+}
+
+long long GetProcessCpuTimeUSec()
+{
+#ifdef __linux__
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage))
+		return 0;
+	return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000LL + usage.ru_utime.tv_usec +
+		usage.ru_stime.tv_usec;
+#else
+	return 0;
+#endif
+}
+
+// Nearest-rank percentile: the smallest sample with at least the given fraction of samples at or below it
+static float NearestRank(const PODVector<float>& sorted, float fraction)
+{
+	int rank = CeilToInt(fraction * sorted.Size()) - 1;
+	return sorted[Clamp(rank, 0, (int)sorted.Size() - 1)];
+}
+
+TimingStats ComputeTimingStats(PODVector<float>& samples)
+{
+	TimingStats stats;
+	if (samples.Empty())
+		return stats;
+
+	Sort(samples.Begin(), samples.End());
+
+	float sum = 0.0f;
+	for (unsigned i = 0; i < samples.Size(); ++i)
+		sum += samples[i];
+
+	stats.count_ = samples.Size();
+	stats.mean_ = sum / samples.Size();
+	stats.p50_ = NearestRank(samples, 0.50f);
+	stats.p95_ = NearestRank(samples, 0.95f);
+	stats.p99_ = NearestRank(samples, 0.99f);
+	stats.max_ = samples.Back();
+	return stats;
+}
+
+void BenchmarkReport::SetRaw(const String& key, const String& json)
+{
+	for (unsigned i = 0; i < entries_.Size(); ++i)
+	{
+		if (entries_[i].first_ == key)
+		{
+			entries_[i].second_ = json;
+			return;
+		}
+	}
+	entries_.Push(MakePair(key, json));
+}
+
+void BenchmarkReport::Set(const String& key, const String& value)
+{
+	String escaped = value;
+	escaped.Replace("\\", "\\\\");
+	escaped.Replace("\"", "\\\"");
+	SetRaw(key, "\"" + escaped + "\"");
+}
+
+void BenchmarkReport::Set(const String& key, int value)
+{
+	SetRaw(key, String(value));
+}
+
+void BenchmarkReport::Set(const String& key, unsigned value)
+{
+	SetRaw(key, String(value));
+}
+
+void BenchmarkReport::Set(const String& key, float value)
+{
+	SetRaw(key, String(value));
+}
+
+void BenchmarkReport::Set(const String& key, const TimingStats& stats)
+{
+	String json;
+	json.AppendWithFormat("{ \"count\": %u, \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f }",
+		stats.count_, stats.mean_, stats.p50_, stats.p95_, stats.p99_, stats.max_);
+	SetRaw(key, json);
+}
+
+String BenchmarkReport::ToString() const
+{
+	String json("{\n");
+	for (unsigned i = 0; i < entries_.Size(); ++i)
+	{
+		json += "\t\"" + entries_[i].first_ + "\": " + entries_[i].second_;
+		json += i + 1 < entries_.Size() ? ",\n" : "\n";
+	}
+	json += "}\n";
+	return json;
+}
+
+bool BenchmarkReport::Save(Context* context, const String& fileName) const
+{
+	File file(context);
+	if (!file.Open(fileName, FILE_WRITE))
+		return false;
+	String json = ToString();
+	file.Write(json.CString(), json.Length());
+	return true;
+}
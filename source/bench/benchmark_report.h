@@ -0,0 +1,71 @@
+#ifndef BENCHMARK_REPORT_H
+#define BENCHMARK_REPORT_H
+
+#include <Urho3D/Container/Pair.h>
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/Container/Vector.h>
+
+#include "../command_line.h"
+
+using namespace Urho3D;
+
+namespace Urho3D
+{
+	class Context;
+}
+
+/// Order statistics over a set of timing samples, in milliseconds.
+struct TimingStats
+{
+	TimingStats() :
+		count_(0),
+		mean_(0.0f),
+		p50_(0.0f),
+		p95_(0.0f),
+		p99_(0.0f),
+		max_(0.0f)
+	{
+	}
+
+	unsigned count_;
+	float mean_;
+	float p50_;
+	float p95_;
+	float p99_;
+	float max_;
+};
+
+/// Compute nearest-rank percentiles of the samples. The samples are sorted in place.
+TimingStats ComputeTimingStats(PODVector<float>& samples);
+
+/// Return resident set size of the process in kilobytes, or its high-water mark if peak is true. Zero where the
+/// platform does not expose it.
+unsigned GetProcessMemoryKB(bool peak);
+
+/// Return CPU time (user plus system, all threads) used by the process so far, in microseconds. Zero where the
+/// platform does not expose it.
+long long GetProcessCpuTimeUSec();
+
+/// Flat, ordered key/value report written out as a single JSON object so CI can diff runs.
+class BenchmarkReport
+{
+public:
+	void Set(const String& key, const String& value);
+	void Set(const String& key, int value);
+	void Set(const String& key, unsigned value);
+	void Set(const String& key, float value);
+	void Set(const String& key, const TimingStats& stats);
+
+	/// Write the report. Returns false if the file could not be opened.
+	bool Save(Context* context, const String& fileName) const;
+	/// Return the report as JSON text.
+	String ToString() const;
+
+private:
+	// Entries in insertion order; values are already JSON-encoded
+	Vector<Pair<String, String> > entries_;
+
+	void SetRaw(const String& key, const String& json);
+};
+
+#endif
@@ -0,0 +1,141 @@
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Math/Random.h>
+#include <Urho3D/Network/Connection.h>
+#include <Urho3D/Network/Network.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "bot_clients.h"
+
+using namespace Urho3D;
+
+BotClients::BotClients(Context* context) :
+	Object(context),
+	address_("localhost"),
+	port_(2345),
+	bounds_(Vector3(-500.0f, 0.0f, -500.0f), Vector3(500.0f, 0.0f, 500.0f)),
+	speed_(10.0f),
+	tickRate_(30)
+{
+	SubscribeToEvent(E_UPDATE, URHO3D_HANDLER(BotClients, HandleUpdate));
+}
+
+BotClients::~BotClients()
+{
+	RemoveAllBots();
+}
+
+void BotClients::SetServer(const String& address, unsigned short port)
+{
+	address_ = address;
+	port_ = port;
+}
+
+void BotClients::SetTickRate(int fps)
+{
+	tickRate_ = fps;
+	for (unsigned i = 0; i < bots_.Size(); ++i)
+		bots_[i].network_->SetUpdateFps(fps);
+}
+
+void BotClients::AddBots(unsigned count)
+{
+	for (unsigned i = 0; i < count; ++i)
+	{
+		Bot bot;
+		bot.network_ = new Network(context_);
+		bot.network_->SetUpdateFps(tickRate_);
+		// Empty replica; the server sends everything that is replicated
+		bot.scene_ = new Scene(context_);
+		bot.position_ = PickPoint();
+		bot.target_ = PickPoint();
+		if (!bot.network_->Connect(address_, port_, bot.scene_))
+		{
+			URHO3D_LOGERRORF("Bot could not connect to %s:%d", address_.CString(), port_);
+			continue;
+		}
+		bots_.Push(bot);
+	}
+}
+
+void BotClients::RemoveAllBots()
+{
+	for (unsigned i = 0; i < bots_.Size(); ++i)
+		bots_[i].network_->Disconnect();
+	bots_.Clear();
+}
+
+unsigned BotClients::GetNumConnected() const
+{
+	unsigned connected = 0;
+	for (unsigned i = 0; i < bots_.Size(); ++i)
+	{
+		Connection* connection = bots_[i].network_->GetServerConnection();
+		if (connection && connection->IsSceneLoaded())
+			++connected;
+	}
+	return connected;
+}
+
+float BotClients::GetBytesInPerBot() const
+{
+	float total = 0.0f;
+	unsigned connected = 0;
+	for (unsigned i = 0; i < bots_.Size(); ++i)
+	{
+		Connection* connection = bots_[i].network_->GetServerConnection();
+		if (!connection)
+			continue;
+		total += connection->GetBytesInPerSec();
+		++connected;
+	}
+	return connected ? total / connected : 0.0f;
+}
+
+float BotClients::GetReplicatedNodesPerBot() const
+{
+	unsigned total = 0;
+	unsigned connected = 0;
+	PODVector<Node*> nodes;
+	for (unsigned i = 0; i < bots_.Size(); ++i)
+	{
+		if (!bots_[i].network_->GetServerConnection())
+			continue;
+		bots_[i].scene_->GetChildren(nodes, true);
+		total += nodes.Size();
+		++connected;
+	}
+	return connected ? (float)total / connected : 0.0f;
+}
+
+Vector3 BotClients::PickPoint() const
+{
+	return Vector3(Random(bounds_.min_.x_, bounds_.max_.x_), Random(bounds_.min_.y_, bounds_.max_.y_),
+		Random(bounds_.min_.z_, bounds_.max_.z_));
+}
+
+void BotClients::HandleUpdate(StringHash eventType, VariantMap& eventData)
+{
+	using namespace Update;
+
+	float step = speed_ * eventData[P_TIMESTEP].GetFloat();
+	for (unsigned i = 0; i < bots_.Size(); ++i)
+	{
+		Bot& bot = bots_[i];
+		Vector3 toTarget = bot.target_ - bot.position_;
+		float distance = toTarget.Length();
+		if (distance <= step)
+		{
+			bot.position_ = bot.target_;
+			bot.target_ = PickPoint();
+		}
+		else
+			bot.position_ += toTarget * (step / distance);
+
+		// Sent to the server with each client update, where it drives interest management
+		Connection* connection = bot.network_->GetServerConnection();
+		if (connection)
+			connection->SetPosition(bot.position_);
+	}
+}
@@ -0,0 +1,73 @@
+#ifndef BOT_CLIENTS_H
+#define BOT_CLIENTS_H
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Math/BoundingBox.h>
+
+using namespace Urho3D;
+
+namespace Urho3D
+{
+	class Network;
+	class Scene;
+}
+
+/// Simulated clients for load testing a DedicatedServer from one process. Each bot has its own Network instance
+/// (the Network subsystem holds only one server connection) and its own replica scene, and wanders its observer
+/// position around the bounds so the server's interest management sees moving clients.
+class BotClients : public Object
+{
+	URHO3D_OBJECT(BotClients, Object);
+
+public:
+	/// Construct.
+	BotClients(Context* context);
+	/// Destruct. Disconnects all bots.
+	virtual ~BotClients();
+
+	/// Set server to connect new bots to.
+	void SetServer(const String& address, unsigned short port);
+	/// Set area the bots' observers wander in.
+	void SetBounds(const BoundingBox& bounds) { bounds_ = bounds; }
+	/// Set observer speed in world units per second.
+	void SetSpeed(float speed) { speed_ = speed; }
+	/// Set client updates per second.
+	void SetTickRate(int fps);
+	/// Connect count more bots.
+	void AddBots(unsigned count);
+	/// Disconnect and remove all bots.
+	void RemoveAllBots();
+
+	/// Return number of bots.
+	unsigned GetNumBots() const { return bots_.Size(); }
+	/// Return number of bots connected with their scene loaded.
+	unsigned GetNumConnected() const;
+	/// Return mean bytes per second currently received by each connected bot.
+	float GetBytesInPerBot() const;
+	/// Return mean number of replicated nodes in each connected bot's scene.
+	float GetReplicatedNodesPerBot() const;
+
+private:
+	/// One simulated client.
+	struct Bot
+	{
+		SharedPtr<Network> network_;
+		SharedPtr<Scene> scene_;
+		Vector3 position_;
+		Vector3 target_;
+	};
+
+	Vector<Bot> bots_;
+	String address_;
+	unsigned short port_;
+	BoundingBox bounds_;
+	float speed_;
+	int tickRate_;
+
+	// Return a random point in the bounds
+	Vector3 PickPoint() const;
+	// Move the bots' observers
+	void HandleUpdate(StringHash eventType, VariantMap& eventData);
+};
+
+#endif
@@ -0,0 +1,33 @@
+#include <Urho3D/Core/ProcessUtils.h>
+
+#include "command_line.h"
+
+using namespace Urho3D;
+
+// Return whether an argument is "-name", ignoring case
+static bool IsArgument(const String& argument, const String& name)
+{
+	return argument.Length() > 1 && argument[0] == '-' && argument.Substring(1).ToLower() == name;
+}
+
+String GetArgumentValue(const String& name, const String& defaultValue)
+{
+	const Vector<String>& arguments = GetArguments();
+	for (unsigned i = 0; i + 1 < arguments.Size(); ++i)
+	{
+		if (IsArgument(arguments[i], name))
+			return arguments[i + 1];
+	}
+	return defaultValue;
+}
+
+bool HasArgument(const String& name)
+{
+	const Vector<String>& arguments = GetArguments();
+	for (unsigned i = 0; i < arguments.Size(); ++i)
+	{
+		if (IsArgument(arguments[i], name))
+			return true;
+	}
+	return false;
+}
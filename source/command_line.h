@@ -0,0 +1,14 @@
+#ifndef COMMAND_LINE_H
+#define COMMAND_LINE_H
+
+#include <Urho3D/Container/Str.h>
+
+using namespace Urho3D;
+
+/// Return the value following a "-name" command line argument, or defaultValue if it is not given. The name is
+/// matched case-insensitively and without its leading '-'.
+String GetArgumentValue(const String& name, const String& defaultValue);
+/// Return whether a "-name" command line flag is given, matched the same way as GetArgumentValue().
+bool HasArgument(const String& name);
+
+#endif
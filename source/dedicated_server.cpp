@@ -0,0 +1,539 @@
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Graphics/DebugRenderer.h>
+#include <Urho3D/Graphics/Model.h>
+#include <Urho3D/Graphics/StaticModel.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Network/Connection.h>
+#include <Urho3D/Network/Network.h>
+#include <Urho3D/Network/NetworkEvents.h>
+#include <Urho3D/Physics/PhysicsWorld.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Scene/Scene.h>
+#include <Urho3D/Scene/SceneEvents.h>
+
+#include "agent_system.h"
+#include "dedicated_server.h"
+#include "telemetry.h"
+
+using namespace Urho3D;
+
+// Copies are dropped this much further out than nodes are added
+static const float REMOVAL_RADIUS_SCALE = 1.1f;
+
+// Copy the network attributes of source that differ to dest. Returns true if any were set
+static bool MirrorAttributes(const Serializable* source, Serializable* dest)
+{
+	const Vector<AttributeInfo>* attributes = source->GetNetworkAttributes();
+	if (!attributes)
+		return false;
+	bool changed = false;
+	Variant value;
+	Variant current;
+	for (unsigned i = 0; i < attributes->Size(); ++i)
+	{
+		const AttributeInfo& attr = attributes->At(i);
+		// IDs would have to be mapped to the replica's own nodes and components
+		if (attr.mode_ & (AM_NODEID | AM_NODEIDVECTOR | AM_COMPONENTID))
+			continue;
+		source->OnGetAttribute(attr, value);
+		dest->OnGetAttribute(attr, current);
+		if (value != current)
+		{
+			dest->OnSetAttribute(attr, value);
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+InterestManager::InterestManager(Context* context) :
+	Component(context),
+	radius_(100.0f),
+	relevantPerClient_(0.0f),
+	replicatedPerClient_(0.0f),
+	cellSize_(1.0f),
+	gridWidth_(0),
+	gridHeight_(0)
+{
+}
+
+InterestManager::~InterestManager()
+{
+	RemoveAllClients();
+}
+
+void InterestManager::RegisterObject(Context* context)
+{
+	context->RegisterFactory<InterestManager>();
+
+	URHO3D_ACCESSOR_ATTRIBUTE("Radius", GetRadius, SetRadius, float, 100.0f, AM_DEFAULT);
+}
+
+void InterestManager::OnSceneSet(Scene* scene)
+{
+	RemoveAllClients();
+	nodes_.Clear();
+	if (!scene)
+	{
+		UnsubscribeFromAllEvents();
+		return;
+	}
+
+	SubscribeToEvent(scene, E_NODEADDED, URHO3D_HANDLER(InterestManager, HandleNodeAdded));
+	PODVector<Node*> nodes;
+	scene->GetChildren(nodes, true);
+	for (unsigned i = 0; i < nodes.Size(); ++i)
+		ManageNode(nodes[i]);
+}
+
+void InterestManager::ManageNode(Node* node)
+{
+	// Local nodes are never sent, and the scene root is copied when a replica is created
+	if (node->GetID() >= FIRST_LOCAL_ID || node == GetScene())
+		return;
+	nodes_.Push(WeakPtr<Node>(node));
+}
+
+void InterestManager::HandleNodeAdded(StringHash eventType, VariantMap& eventData)
+{
+	using namespace NodeAdded;
+
+	Node* node = static_cast<Node*>(eventData[P_NODE].GetPtr());
+	ManageNode(node);
+	PODVector<Node*> children;
+	node->GetChildren(children, true);
+	for (unsigned i = 0; i < children.Size(); ++i)
+		ManageNode(children[i]);
+}
+
+void InterestManager::AddClient(Connection* connection)
+{
+	Scene* scene = GetScene();
+	if (!scene || !connection)
+		return;
+
+	ClientReplica client;
+	client.connection_ = connection;
+	client.scene_ = new Scene(context_);
+	client.scene_->SetName(scene->GetName());
+	// Replicas only hold state to send; nothing in them is simulated
+	client.scene_->SetUpdateEnabled(false);
+	// Every replica holds its own copy of the root components, so only those clients use are cloned. Clients do not
+	// simulate physics, and debug geometry is drawn by each client for itself
+	const Vector<SharedPtr<Component> >& components = scene->GetComponents();
+	for (unsigned i = 0; i < components.Size(); ++i)
+	{
+		Component* component = components[i];
+		if (component->GetID() < FIRST_LOCAL_ID && component->GetType() != PhysicsWorld::GetTypeStatic() &&
+			component->GetType() != DebugRenderer::GetTypeStatic())
+			client.scene_->CloneComponent(component, REPLICATED);
+	}
+	clients_.Push(client);
+	connection->SetScene(client.scene_);
+}
+
+void InterestManager::RemoveClient(Connection* connection)
+{
+	for (unsigned i = 0; i < clients_.Size(); ++i)
+	{
+		if (clients_[i].connection_ == connection)
+		{
+			if (connection->GetScene() == clients_[i].scene_)
+				connection->SetScene(0);
+			clients_.Erase(i);
+			return;
+		}
+	}
+}
+
+void InterestManager::RemoveAllClients()
+{
+	for (unsigned i = 0; i < clients_.Size(); ++i)
+	{
+		Connection* connection = clients_[i].connection_;
+		if (connection && connection->GetScene() == clients_[i].scene_)
+			connection->SetScene(0);
+	}
+	clients_.Clear();
+}
+
+Node* InterestManager::GetOrCreateProxy(ClientReplica& client, Node* node)
+{
+	HashMap<unsigned, Proxy>::Iterator i = client.proxies_.Find(node->GetID());
+	if (i != client.proxies_.End() && i->second_.copy_)
+		return i->second_.copy_;
+
+	// Replicated nodes under the root or under a local node go to the replica's root
+	Node* parent = node->GetParent();
+	Node* proxyParent = !parent || parent == GetScene() || parent->GetID() >= FIRST_LOCAL_ID ?
+		client.scene_.Get() : GetOrCreateProxy(client, parent);
+	Node* copy = proxyParent->CreateChild(node->GetName(), REPLICATED);
+	MirrorNode(node, copy);
+	Proxy& proxy = client.proxies_[node->GetID()];
+	proxy.node_ = node;
+	proxy.copy_ = copy;
+	return copy;
+}
+
+void InterestManager::MirrorNode(Node* node, Node* copy)
+{
+	// Setting an unchanged value would still mark the node for a network update check
+	if (copy->GetPosition() != node->GetPosition() || copy->GetRotation() != node->GetRotation() ||
+		copy->GetScale() != node->GetScale())
+		copy->SetTransform(node->GetPosition(), node->GetRotation(), node->GetScale());
+	if (copy->IsEnabled() != node->IsEnabled())
+		copy->SetEnabled(node->IsEnabled());
+	if (copy->GetName() != node->GetName())
+		copy->SetName(node->GetName());
+	const VariantMap& vars = node->GetVars();
+	for (VariantMap::ConstIterator i = vars.Begin(); i != vars.End(); ++i)
+	{
+		if (copy->GetVar(i->first_) != i->second_)
+			copy->SetVar(i->first_, i->second_);
+	}
+
+	// The copy holds clones of the replicated components in the same order. Mirror them pairwise, or clone them
+	// again if components were added or removed since
+	const Vector<SharedPtr<Component> >& components = node->GetComponents();
+	const Vector<SharedPtr<Component> >& copies = copy->GetComponents();
+	unsigned numCopies = 0;
+	bool matching = true;
+	for (unsigned i = 0; i < components.Size() && matching; ++i)
+	{
+		Component* component = components[i];
+		if (component->GetID() >= FIRST_LOCAL_ID)
+			continue;
+		if (numCopies < copies.Size() && copies[numCopies]->GetType() == component->GetType())
+		{
+			Component* componentCopy = copies[numCopies++];
+			if (MirrorAttributes(component, componentCopy))
+			{
+				componentCopy->ApplyAttributes();
+				componentCopy->MarkNetworkUpdate();
+			}
+		}
+		else
+			matching = false;
+	}
+	if (matching && numCopies == copies.Size())
+		return;
+	copy->RemoveAllComponents();
+	for (unsigned i = 0; i < components.Size(); ++i)
+	{
+		if (components[i]->GetID() < FIRST_LOCAL_ID)
+			copy->CloneComponent(components[i], REPLICATED);
+	}
+}
+
+void InterestManager::BuildGrid()
+{
+	const unsigned count = nodes_.Size();
+	positions_.Resize(count);
+	Vector2 min(M_INFINITY, M_INFINITY);
+	Vector2 max(-M_INFINITY, -M_INFINITY);
+	for (unsigned i = 0; i < count; ++i)
+	{
+		positions_[i] = nodes_[i]->GetWorldPosition();
+		min.x_ = Min(min.x_, positions_[i].x_);
+		min.y_ = Min(min.y_, positions_[i].z_);
+		max.x_ = Max(max.x_, positions_[i].x_);
+		max.y_ = Max(max.y_, positions_[i].z_);
+	}
+	if (!count)
+		min = max = Vector2::ZERO;
+
+	// Cells the size of the radius keep a query to a few cells. Sparse scenes get larger cells, so that empty cells
+	// never far outnumber the nodes
+	const Vector2 size = max - min;
+	gridOrigin_ = min;
+	cellSize_ = radius_;
+	while ((size.x_ / cellSize_ + 1.0f) * (size.y_ / cellSize_ + 1.0f) > 4.0f * count + 16.0f)
+		cellSize_ *= 2.0f;
+	gridWidth_ = (int)(size.x_ / cellSize_) + 1;
+	gridHeight_ = (int)(size.y_ / cellSize_) + 1;
+
+	// Counting sort: count the nodes in each cell, sum the counts into cell ends, then fill each cell from its end
+	const unsigned numCells = (unsigned)(gridWidth_ * gridHeight_);
+	cellStarts_.Resize(numCells + 1);
+	for (unsigned i = 0; i <= numCells; ++i)
+		cellStarts_[i] = 0;
+	for (unsigned i = 0; i < count; ++i)
+	{
+		const IntVector2 cell = GetCell(positions_[i].x_, positions_[i].z_);
+		++cellStarts_[cell.y_ * gridWidth_ + cell.x_];
+	}
+	for (unsigned i = 1; i < numCells; ++i)
+		cellStarts_[i] += cellStarts_[i - 1];
+	cellStarts_[numCells] = count;
+	cellNodes_.Resize(count);
+	for (unsigned i = count - 1; i < count; --i)
+	{
+		const IntVector2 cell = GetCell(positions_[i].x_, positions_[i].z_);
+		cellNodes_[--cellStarts_[cell.y_ * gridWidth_ + cell.x_]] = i;
+	}
+}
+
+IntVector2 InterestManager::GetCell(float x, float z) const
+{
+	return IntVector2(Clamp((int)floorf((x - gridOrigin_.x_) / cellSize_), 0, gridWidth_ - 1),
+		Clamp((int)floorf((z - gridOrigin_.y_) / cellSize_), 0, gridHeight_ - 1));
+}
+
+void InterestManager::UpdateReplicas()
+{
+	TELEMETRY_SCOPE("server.interest");
+
+	// Forget disconnected clients and removed nodes. Copies of removed nodes go below
+	for (unsigned i = clients_.Size() - 1; i < clients_.Size(); --i)
+	{
+		if (!clients_[i].connection_)
+			clients_.Erase(i);
+	}
+	for (unsigned i = nodes_.Size() - 1; i < nodes_.Size(); --i)
+	{
+		if (!nodes_[i])
+			nodes_.Erase(i);
+	}
+	if (clients_.Empty())
+	{
+		relevantPerClient_ = 0.0f;
+		replicatedPerClient_ = 0.0f;
+		return;
+	}
+	BuildGrid();
+
+	// Same distance NetworkPriority measures: node world position to the connection's observer position
+	const float radiusSquared = radius_ * radius_;
+	const float removalRadius = radius_ * REMOVAL_RADIUS_SCALE;
+	const float removalRadiusSquared = removalRadius * removalRadius;
+	unsigned relevant = 0;
+	unsigned replicated = 0;
+	for (unsigned i = 0; i < clients_.Size(); ++i)
+	{
+		ClientReplica& client = clients_[i];
+		const Vector3 observer = client.connection_->GetPosition();
+
+		// Drop copies of removed nodes and of nodes past the removal radius, and bring the rest up to date.
+		// Parents of copies still sent stay until their children have gone
+		for (HashMap<unsigned, Proxy>::Iterator j = client.proxies_.Begin(); j != client.proxies_.End();)
+		{
+			Node* node = j->second_.node_;
+			Node* copy = j->second_.copy_;
+			if (node && copy && ((node->GetWorldPosition() - observer).LengthSquared() <= removalRadiusSquared ||
+				copy->GetNumChildren()))
+			{
+				MirrorNode(node, copy);
+				++j;
+				continue;
+			}
+			if (copy)
+				copy->Remove();
+			j = client.proxies_.Erase(j);
+		}
+
+		// Only the cells the radius overlaps on the XZ plane can hold nodes within it
+		const IntVector2 low = GetCell(observer.x_ - radius_, observer.z_ - radius_);
+		const IntVector2 high = GetCell(observer.x_ + radius_, observer.z_ + radius_);
+		for (int y = low.y_; y <= high.y_; ++y)
+		{
+			for (int x = low.x_; x <= high.x_; ++x)
+			{
+				const unsigned cell = (unsigned)(y * gridWidth_ + x);
+				for (unsigned j = cellStarts_[cell]; j < cellStarts_[cell + 1]; ++j)
+				{
+					const unsigned index = cellNodes_[j];
+					if ((positions_[index] - observer).LengthSquared() > radiusSquared)
+						continue;
+					++relevant;
+					Node* node = nodes_[index];
+					if (!client.proxies_.Contains(node->GetID()))
+						GetOrCreateProxy(client, node);
+				}
+			}
+		}
+		replicated += client.proxies_.Size();
+	}
+	relevantPerClient_ = (float)relevant / clients_.Size();
+	replicatedPerClient_ = (float)replicated / clients_.Size();
+}
+
+DedicatedServer::DedicatedServer(Context* context) :
+	Object(context),
+	interestRadius_(100.0f)
+{
+	SetNetwork(GetSubsystem<Network>());
+}
+
+DedicatedServer::~DedicatedServer()
+{
+	Stop();
+}
+
+void DedicatedServer::SetNetwork(Network* network)
+{
+	if (network_)
+		UnsubscribeFromEvents(network_);
+	network_ = network;
+	if (!network_)
+		return;
+	SubscribeToEvent(network_, E_CLIENTCONNECTED, URHO3D_HANDLER(DedicatedServer, HandleClientConnected));
+	SubscribeToEvent(network_, E_CLIENTDISCONNECTED, URHO3D_HANDLER(DedicatedServer, HandleClientDisconnected));
+	SubscribeToEvent(network_, E_NETWORKUPDATE, URHO3D_HANDLER(DedicatedServer, HandleNetworkUpdate));
+	SubscribeToEvent(network_, E_NETWORKUPDATESENT, URHO3D_HANDLER(DedicatedServer, HandleNetworkUpdateSent));
+}
+
+bool DedicatedServer::Start(Scene* scene, unsigned short port)
+{
+	if (!network_ || !scene)
+		return false;
+	scene_ = scene;
+	interest_ = scene->GetOrCreateComponent<InterestManager>(LOCAL);
+	interest_->SetRadius(interestRadius_);
+	if (!network_->StartServer(port))
+	{
+		URHO3D_LOGERRORF("Could not start server on port %d", port);
+		return false;
+	}
+	// The scene is updated from HandleUpdate() instead, so its update time can be measured
+	scene_->SetUpdateEnabled(false);
+	SubscribeToEvent(E_UPDATE, URHO3D_HANDLER(DedicatedServer, HandleUpdate));
+	URHO3D_LOGINFOF("Serving scene on port %d, interest radius %.1f", port, interestRadius_);
+	return true;
+}
+
+void DedicatedServer::Stop()
+{
+	if (network_ && network_->IsServerRunning())
+		network_->StopServer();
+	if (interest_)
+		interest_->RemoveAllClients();
+	if (scene_)
+		scene_->SetUpdateEnabled(true);
+	UnsubscribeFromEvent(E_UPDATE);
+	ResetStats();
+}
+
+void DedicatedServer::ResetStats()
+{
+	tickTimes_.Clear();
+	updateTimes_.Clear();
+}
+
+void DedicatedServer::SpawnAgents(unsigned count, const BoundingBox& bounds)
+{
+	if (!scene_ || !count)
+		return;
+	Model* model = GetSubsystem<ResourceCache>()->GetResource<Model>("Models/Box.mdl");
+
+	// The agents node is replicated too, so clients can resolve the agents' parent
+	Node* agentsNode = scene_->CreateChild("Agents", REPLICATED);
+	AgentSystem* agents = agentsNode->CreateComponent<AgentSystem>(LOCAL);
+	agents->SetBounds(bounds);
+	const unsigned side = (unsigned)ceilf(sqrtf((float)count));
+	const Vector3 size = bounds.Size();
+	for (unsigned i = 0; i < count; ++i)
+	{
+		Vector3 position(bounds.min_.x_ + size.x_ * (i % side) / side, bounds.min_.y_,
+			bounds.min_.z_ + size.z_ * (i / side) / side);
+		Node* node = agentsNode->CreateChild(String::EMPTY, REPLICATED);
+		node->SetPosition(position);
+		StaticModel* staticModel = node->CreateComponent<StaticModel>(REPLICATED);
+		staticModel->SetModel(model);
+		agents->AddAgent(node, position);
+	}
+}
+
+void DedicatedServer::SetTickRate(int fps)
+{
+	if (network_)
+		network_->SetUpdateFps(fps);
+}
+
+void DedicatedServer::SetInterestRadius(float radius)
+{
+	interestRadius_ = radius;
+	if (interest_)
+		interest_->SetRadius(radius);
+}
+
+unsigned DedicatedServer::GetNumClients() const
+{
+	return network_ ? network_->GetClientConnections().Size() : 0;
+}
+
+float DedicatedServer::GetBytesOutPerClient() const
+{
+	if (!network_)
+		return 0.0f;
+	Vector<SharedPtr<Connection> > connections = network_->GetClientConnections();
+	if (connections.Empty())
+		return 0.0f;
+	float total = 0.0f;
+	for (unsigned i = 0; i < connections.Size(); ++i)
+		total += connections[i]->GetBytesOutPerSec();
+	return total / connections.Size();
+}
+
+float DedicatedServer::GetRelevantNodesPerClient() const
+{
+	return interest_ ? interest_->GetRelevantNodesPerClient() : 0.0f;
+}
+
+float DedicatedServer::GetReplicatedNodesPerClient() const
+{
+	return interest_ ? interest_->GetReplicatedNodesPerClient() : 0.0f;
+}
+
+void DedicatedServer::HandleClientConnected(StringHash eventType, VariantMap& eventData)
+{
+	using namespace ClientConnected;
+
+	Connection* connection = static_cast<Connection*>(eventData[P_CONNECTION].GetPtr());
+	if (interest_)
+		interest_->AddClient(connection);
+}
+
+void DedicatedServer::HandleClientDisconnected(StringHash eventType, VariantMap& eventData)
+{
+	using namespace ClientDisconnected;
+
+	Connection* connection = static_cast<Connection*>(eventData[P_CONNECTION].GetPtr());
+	if (interest_)
+		interest_->RemoveClient(connection);
+}
+
+void DedicatedServer::HandleUpdate(StringHash eventType, VariantMap& eventData)
+{
+	using namespace Update;
+
+	if (!scene_)
+		return;
+	HiresTimer timer;
+	scene_->Update(eventData[P_TIMESTEP].GetFloat());
+	float updateMs = timer.GetUSec(false) / 1000.0f;
+	updateTimes_.Push(updateMs);
+	Telemetry* telemetry = GetSubsystem<Telemetry>();
+	if (telemetry)
+		telemetry->Record("server.update", updateMs);
+}
+
+void DedicatedServer::HandleNetworkUpdate(StringHash eventType, VariantMap& eventData)
+{
+	if (!network_->IsServerRunning())
+		return;
+	tickTimer_.Reset();
+	if (interest_)
+		interest_->UpdateReplicas();
+}
+
+void DedicatedServer::HandleNetworkUpdateSent(StringHash eventType, VariantMap& eventData)
+{
+	if (!network_->IsServerRunning())
+		return;
+	float tickMs = tickTimer_.GetUSec(false) / 1000.0f;
+	tickTimes_.Push(tickMs);
+	Telemetry* telemetry = GetSubsystem<Telemetry>();
+	if (telemetry)
+		telemetry->Record("server.tick", tickMs);
+}
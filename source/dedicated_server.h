@@ -0,0 +1,176 @@
+#ifndef DEDICATED_SERVER_H
+#define DEDICATED_SERVER_H
+
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Math/BoundingBox.h>
+#include <Urho3D/Scene/Component.h>
+
+using namespace Urho3D;
+
+namespace Urho3D
+{
+	class Connection;
+	class Network;
+}
+
+/// Server-side interest management. Connection replicates every node of its scene, with no per-client filter, so
+/// each client is given its own replica scene instead of the hosted one. On every network tick the replicated nodes
+/// within the interest radius of the client's observer position (Connection::SetPosition() on the client) are
+/// mirrored into the replica, with their parents. Copies are dropped only once their node is beyond 1.1 times the
+/// radius, so nodes at the edge do not enter and leave on alternate ticks. A client therefore never receives nodes
+/// outside that distance, on the initial replication or later. Relevance is a distance test on node world positions
+/// and does not depend on the Octree being updated: each tick the managed nodes are bucketed into a uniform grid on
+/// the XZ plane, so a client only tests the nodes in the cells its radius overlaps. Every tick each copy gets its node's transform, enabled state,
+/// name and variables and the replicated attributes of its replicated components, setting only values that changed
+/// so Connection still sends per-attribute deltas. Attributes holding node or component IDs are not mirrored, as
+/// the IDs would differ in the replica. Of the scene's replicated root components only those clients need are
+/// cloned into each replica; PhysicsWorld and DebugRenderer stay on the server.
+class InterestManager : public Component
+{
+	URHO3D_OBJECT(InterestManager, Component);
+
+public:
+	/// Construct.
+	InterestManager(Context* context);
+	/// Destruct. Detaches clients from their replicas.
+	virtual ~InterestManager();
+	/// Register object factory and attributes.
+	static void RegisterObject(Context* context);
+
+	/// Give a client its replica scene.
+	void AddClient(Connection* connection);
+	/// Remove a client's replica scene.
+	void RemoveClient(Connection* connection);
+	/// Remove all clients' replica scenes.
+	void RemoveAllClients();
+	/// Refresh every client's replica from the hosted scene. Called by DedicatedServer before each network update.
+	void UpdateReplicas();
+
+	/// Set interest radius in world units.
+	void SetRadius(float radius) { radius_ = Max(radius, M_EPSILON); }
+	float GetRadius() const { return radius_; }
+	/// Return mean number of replicated nodes in range of a client at the last update.
+	float GetRelevantNodesPerClient() const { return relevantPerClient_; }
+	/// Return mean number of nodes in a client's replica at the last update, which includes the parents of nodes in
+	/// range.
+	float GetReplicatedNodesPerClient() const { return replicatedPerClient_; }
+	/// Return number of replicated nodes under interest management.
+	unsigned GetNumManagedNodes() const { return nodes_.Size(); }
+
+protected:
+	/// Handle scene being assigned.
+	virtual void OnSceneSet(Scene* scene);
+
+private:
+	/// Hosted node and a client's copy of it.
+	struct Proxy
+	{
+		WeakPtr<Node> node_;
+		WeakPtr<Node> copy_;
+	};
+
+	/// Scene sent to one client, and its copies of hosted nodes by hosted node ID.
+	struct ClientReplica
+	{
+		WeakPtr<Connection> connection_;
+		SharedPtr<Scene> scene_;
+		HashMap<unsigned, Proxy> proxies_;
+	};
+
+	float radius_;
+	float relevantPerClient_;
+	float replicatedPerClient_;
+	Vector<WeakPtr<Node> > nodes_;
+	Vector<ClientReplica> clients_;
+	/// World positions of the managed nodes at the last update.
+	PODVector<Vector3> positions_;
+	/// Indices into nodes_ sorted by grid cell.
+	PODVector<unsigned> cellNodes_;
+	/// First index into cellNodes_ of each grid cell, followed by the number of nodes.
+	PODVector<unsigned> cellStarts_;
+	Vector2 gridOrigin_;
+	float cellSize_;
+	int gridWidth_;
+	int gridHeight_;
+
+	// Start mirroring a replicated node and its replicated descendants
+	void ManageNode(Node* node);
+	// Return a client's copy of a hosted node, creating it and its parents' copies if needed
+	Node* GetOrCreateProxy(ClientReplica& client, Node* node);
+	// Copy what changed on a hosted node and its replicated components to a client's copy
+	void MirrorNode(Node* node, Node* copy);
+	// Bucket the managed nodes by position
+	void BuildGrid();
+	// Return the grid cell holding an XZ position, clamped to the grid
+	IntVector2 GetCell(float x, float z) const;
+	// Handle node added to the scene
+	void HandleNodeAdded(StringHash eventType, VariantMap& eventData);
+};
+
+/// Hosts a scene over the Network subsystem: every client that connects is given a replica of the scene holding only
+/// the replicated nodes near it (see InterestManager). Updates go out at the tick rate. The server drives the hosted
+/// scene's update itself, so the time spent in it and in every network tick (replica update plus serialising
+/// updates for all clients) is measured apart from anything else running in the process.
+class DedicatedServer : public Object
+{
+	URHO3D_OBJECT(DedicatedServer, Object);
+
+public:
+	/// Construct. Uses the Network subsystem.
+	DedicatedServer(Context* context);
+	/// Destruct. Stops the server.
+	virtual ~DedicatedServer();
+
+	/// Start listening and serve the scene. Returns false if the port could not be opened.
+	bool Start(Scene* scene, unsigned short port);
+	/// Disconnect all clients and stop listening.
+	void Stop();
+	/// Add count wandering agents as replicated nodes, each with a replicated box model, simulated by an
+	/// AgentSystem on the server.
+	void SpawnAgents(unsigned count, const BoundingBox& bounds);
+	/// Set network updates per second.
+	void SetTickRate(int fps);
+	/// Set interest radius in world units.
+	void SetInterestRadius(float radius);
+	/// Set the network to serve on. Defaults to the Network subsystem.
+	void SetNetwork(Network* network);
+
+	/// Return number of connected clients.
+	unsigned GetNumClients() const;
+	/// Return mean bytes per second currently sent to each client.
+	float GetBytesOutPerClient() const;
+	/// Return mean number of replicated nodes in range of a client.
+	float GetRelevantNodesPerClient() const;
+	/// Return mean number of nodes in each client's replica.
+	float GetReplicatedNodesPerClient() const;
+	/// Return tick times in milliseconds since the last ResetStats().
+	const PODVector<float>& GetTickTimes() const { return tickTimes_; }
+	/// Return hosted scene update times in milliseconds since the last ResetStats().
+	const PODVector<float>& GetUpdateTimes() const { return updateTimes_; }
+	/// Clear tick and update times.
+	void ResetStats();
+
+private:
+	WeakPtr<Network> network_;
+	WeakPtr<Scene> scene_;
+	WeakPtr<InterestManager> interest_;
+	float interestRadius_;
+	HiresTimer tickTimer_;
+	PODVector<float> tickTimes_;
+	PODVector<float> updateTimes_;
+
+	// Handle client connection
+	void HandleClientConnected(StringHash eventType, VariantMap& eventData);
+	// Handle client disconnection
+	void HandleClientDisconnected(StringHash eventType, VariantMap& eventData);
+	// Update the hosted scene
+	void HandleUpdate(StringHash eventType, VariantMap& eventData);
+	// Handle start of a network tick
+	void HandleNetworkUpdate(StringHash eventType, VariantMap& eventData);
+	// Handle end of a network tick
+	void HandleNetworkUpdateSent(StringHash eventType, VariantMap& eventData);
+};
+
+#endif
@@ -1,12 +1,12 @@
-#include <string>
-#include <sstream>
-
 #include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Core/ProcessUtils.h>
+#include <Urho3D/Core/Timer.h>
 #include <Urho3D/Engine/Application.h>
 #include <Urho3D/Engine/Engine.h>
 #include <Urho3D/Engine/EngineDefs.h>
 #include <Urho3D/Input/Input.h>
 #include <Urho3D/Input/InputEvents.h>
+#include <Urho3D/IO/FileSystem.h>
 #include <Urho3D/Resource/ResourceCache.h>
 #include <Urho3D/Resource/XMLFile.h>
 #include <Urho3D/IO/Log.h>
@@ -28,25 +28,63 @@
 #include <Urho3D/Graphics/StaticModel.h>
 #include <Urho3D/Graphics/Material.h>
 #include <Urho3D/Graphics/Skybox.h>
+#include <Urho3D/Graphics/Terrain.h>
 #include <Urho3D/Physics/PhysicsWorld.h>
 
+#include "agent_system.h"
+#include "bot_clients.h"
+#include "command_line.h"
+#include "dedicated_server.h"
 #include "main.h"
+#include "paged_terrain.h"
+#include "terrain_scatter.h"
+#include "resource_package.h"
+#include "scene_cache.h"
 #include "scene_main.h"
+#include "telemetry.h"
 
 using namespace Urho3D;
 
 //TestScene testScene;
 
+static const char* MAIN_SCENE = "Scenes/TestScene.xml";
+// Area the server's agents and the bots' observers move in
+static const BoundingBox NETWORK_BOUNDS(Vector3(-500.0f, 0.0f, -500.0f), Vector3(500.0f, 0.0f, 500.0f));
+
+// The camera is kept at least this far above the ground
+static const float CAMERA_GROUND_CLEARANCE = 1.5f;
+// How far below the camera to look for ground, and how far above it to look when there is none below
+static const float CAMERA_GROUND_PROBE = 1000.0f;
+
 // Constructor creates the context (before the engine is initialised), and initialises some member variables.
 FirstApp::FirstApp(Context* context) :
 	Application(context),
 	framecount_(0),
-	time_(0)
+	time_(0),
+	sceneLoadTime_(0),
+	timeToFirstFrame_(0),
+	asyncLoading_(true),
+	loadTimeBudgetMs_(5),
+	useSceneCache_(true),
+	resourcePackage_("TestScene.pak"),
+	useResourcePackage_(false),
+	buildPackage_(false),
+	serverMode_(false),
+	numBots_(0),
+	serverAddress_("localhost"),
+	serverPort_(2345),
+	clampCameraToGround_(true),
+	tickRate_(30),
+	interestRadius_(100.0f),
+	serverAgents_(2000)
 {
 }
 
 // Macro to start the application.
+// The benchmark target (fpbench) links this file too and defines its own main().
+#ifndef FPBIN_BENCHMARK
 URHO3D_DEFINE_APPLICATION_MAIN(FirstApp)
+#endif
 
 void FirstApp::Setup()
 {
@@ -58,31 +96,88 @@ void FirstApp::Setup()
 	#else
 	engineParameters_[EP_FULL_SCREEN]	 = true; // Release build has fullscreen
 	#endif
+
+	// "fpbin -telemetry <file>" records per-frame telemetry; off by default as the file grows for as long as the
+	// application runs
+	telemetryFile_ = GetArgumentValue("telemetry", String::EMPTY);
+	// "fpbin -package" writes the resource package for the main scene and exits
+	buildPackage_ = HasArgument("package");
+	// "fpbin -server" hosts the scene for network clients; "fpbin -bots <n>" connects n simulated clients to one
+	serverMode_ = HasArgument("server");
+	numBots_ = ToUInt(GetArgumentValue("bots", "0"));
+	serverAddress_ = GetArgumentValue("connect", serverAddress_);
+	serverPort_ = (unsigned short)ToUInt(GetArgumentValue("port", String(serverPort_)));
+	tickRate_ = ToInt(GetArgumentValue("tickrate", String(tickRate_)));
+	interestRadius_ = ToFloat(GetArgumentValue("interest", String(interestRadius_)));
+	serverAgents_ = ToUInt(GetArgumentValue("agents", String(serverAgents_)));
+	if (buildPackage_ || serverMode_ || numBots_)
+	{
+		engineParameters_[EP_HEADLESS] = true;
+		engineParameters_[EP_FULL_SCREEN] = false;
+	}
+	// "fpbin -usepackage" loads the main scene's resources from the package instead of the loose directories
+	useResourcePackage_ = HasArgument("usepackage");
 }
 
 void FirstApp::Start()
 {
 	// Called after engine initialization. Setup application & subscribe to events here.
+	startTimer_.Reset();
+
+	if (buildPackage_)
+	{
+		// A nonzero exit code returns straight from Run(); there is nothing to clean up in Stop()
+		if (!BuildResourcePackage())
+			exitCode_ = EXIT_FAILURE;
+		engine_->Exit();
+		return;
+	}
 
 	// Load resources (maybe move this block to own function).
 	ResourceCache* cache = GetSubsystem<ResourceCache>();
+	MountResourcePackage();
 	// Use default Urho3D UI style
 	GetSubsystem<UI>()->GetRoot()->SetDefaultStyle(cache->GetResource<XMLFile>("UI/DefaultStyle.xml"));
 	scene_ = new Scene(context_);
 
-	// Load the main scene
-	LoadScene();
+	// Per-frame telemetry, drained to telemetryFile_ on a background thread
+	Telemetry* telemetry = new Telemetry(context_);
+	context_->RegisterSubsystem(telemetry);
+	if (!telemetryFile_.Empty())
+		telemetry->Open(telemetryFile_);
+
+	// Components defined by this application
+	AgentSystem::RegisterObject(context_);
+	PagedTerrain::RegisterObject(context_);
+	TerrainScatter::RegisterObject(context_);
+	InterestManager::RegisterObject(context_);
+
+	// Binary snapshots of XML scenes, used by SceneLoader to skip the XML parse on later launches
+	if (useSceneCache_)
+		context_->RegisterSubsystem(new SceneCache(context_));
+
+	// Host the main scene, run bot clients, or load the scene to play locally
+	if (serverMode_)
+		StartServer();
+	else if (numBots_)
+		StartBots();
+	else
+		LoadScene();
 
 	// Subscribe to the events we want to handle (in this example, that's most of them)
 	SubscribeToEvent(E_KEYDOWN, URHO3D_HANDLER(FirstApp, HandleKeyDown));
 	// For some reason this is throwing an "undefined reference" error.
 	//SubscribeToEvent(E_KEYUP, URHO3D_HANDLER(FirstApp, HandleKeyUp));
 	SubscribeToEvent(E_UPDATE, URHO3D_HANDLER(FirstApp, HandleUpdate));
+	SubscribeToEvent(E_ENDFRAME, URHO3D_HANDLER(FirstApp, HandleEndFrame));
 }
 
 void FirstApp::Stop()
 {
 	// Perform optional cleanup after main loop has terminated
+	Telemetry* telemetry = GetSubsystem<Telemetry>();
+	if (telemetry)
+		telemetry->Close();
 }
 
 void FirstApp::HandleKeyDown(StringHash eventType, VariantMap& eventData)
@@ -112,50 +207,252 @@ void FirstApp::HandleUpdate(StringHash eventType, VariantMap& eventData)
 	// Mouse sensitivity as degrees per pixel
 	const float MOUSE_SENSITIVITY = 0.1f;
 
-	// Draw some basic debug information
+	// Log a one second average; per-frame timings go to the telemetry file
 	if(time_ >= 1)
 	{
-		std::string str;
-		str.append("Keys: AWSD = move camera, Esc = quit.\n");
-		{
-			std::ostringstream ss;
-			ss << framecount_;
-			std::string s(ss.str());
-			str.append(s.substr(0, 6));
-		}
-		str.append(" frames in ");
-		{
-			std::ostringstream ss;
-			ss << time_;
-			std::string s(ss.str());
-			str.append(s.substr(0, 6));
-		}
-		str.append(" seconds = ");
-		{
-			std::ostringstream ss;
-			ss << (float)framecount_ / time_;
-			std::string s(ss.str());
-			str.append(s.substr(0, 6));
-		}
-		str.append(" fps");
-		String s(str.c_str(), str.size());
-		URHO3D_LOGINFO(s); // put stuff in the log
+		URHO3D_LOGINFOF("Keys: AWSD = move camera, Esc = quit.\n%d frames in %.3f seconds = %.2f fps", framecount_,
+			time_, framecount_ / time_);
+		LogNetworkStats();
 		framecount_ = 0;
 		time_ = 0;
 	}
+
+	if (clampCameraToGround_)
+		ClampCameraToGround();
 }
 
-void FirstApp::LoadScene()
+void FirstApp::ClampCameraToGround()
+{
+	if (!cameraNode_ || !sceneLoader_ || sceneLoader_->IsLoading())
+		return;
+	PhysicsWorld* physicsWorld = scene_->GetComponent<PhysicsWorld>();
+	if (!physicsWorld)
+		return;
+	if (!physicsQueries_)
+		physicsQueries_ = new PhysicsQueryBatch(context_);
+
+	// Cast down from just above the camera, so roofs and overhangs above it are never mistaken for the ground
+	Vector3 position = cameraNode_->GetWorldPosition();
+	groundProbes_.Resize(1);
+	groundProbes_[0] = position + Vector3::UP * CAMERA_GROUND_CLEARANCE;
+	physicsQueries_->GroundHeights(physicsWorld, groundProbes_, CAMERA_GROUND_PROBE, M_MAX_UNSIGNED, groundHeights_);
+	if (groundHeights_[0] >= groundProbes_[0].y_)
+	{
+		// Nothing below: the camera may have gone under the ground, so look for it from above
+		groundProbes_[0] = position + Vector3::UP * CAMERA_GROUND_PROBE;
+		physicsQueries_->GroundHeights(physicsWorld, groundProbes_, CAMERA_GROUND_PROBE, M_MAX_UNSIGNED,
+			groundHeights_);
+		if (groundHeights_[0] >= groundProbes_[0].y_)
+			return;
+	}
+	if (position.y_ < groundHeights_[0] + CAMERA_GROUND_CLEARANCE)
+	{
+		position.y_ = groundHeights_[0] + CAMERA_GROUND_CLEARANCE;
+		cameraNode_->SetWorldPosition(position);
+	}
+}
+
+void FirstApp::HandleEndFrame(StringHash eventType, VariantMap& eventData)
+{
+	if (!timeToFirstFrame_)
+	{
+		timeToFirstFrame_ = startTimer_.GetUSec(false);
+		URHO3D_LOGINFOF("Time to first frame: %.2f ms", timeToFirstFrame_ / 1000.0f);
+	}
+}
+
+String FirstApp::GetResourcePackagePath() const
+{
+	if (resourcePackage_.Empty() || IsAbsolutePath(resourcePackage_))
+		return resourcePackage_;
+	return GetSubsystem<FileSystem>()->GetProgramDir() + resourcePackage_;
+}
+
+void FirstApp::MountResourcePackage()
+{
+	if (!useResourcePackage_)
+		return;
+	String path = GetResourcePackagePath();
+	if (path.Empty() || !GetSubsystem<FileSystem>()->FileExists(path))
+	{
+		URHO3D_LOGWARNING("Resource package " + path + " not found, using the resource directories");
+		return;
+	}
+	// Packages are searched before the loose resource directories, which stay as the fallback, only while
+	// searchPackagesFirst is set. It is by default; set it anyway. Priority only orders packages among themselves
+	ResourceCache* cache = GetSubsystem<ResourceCache>();
+	cache->SetSearchPackagesFirst(true);
+	if (cache->AddPackageFile(path, 0))
+		URHO3D_LOGINFO("Mounted resource package " + path);
+}
+
+bool FirstApp::BuildResourcePackage()
+{
+	String path = GetResourcePackagePath();
+	if (path.Empty())
+		return false;
+	SharedPtr<ResourcePackager> packager(new ResourcePackager(context_));
+	if (!packager->AddResource(MAIN_SCENE))
+	{
+		URHO3D_LOGERROR("Could not find " + String(MAIN_SCENE));
+		return false;
+	}
+	return packager->Write(path);
+}
+
+void FirstApp::StartServer()
 {
-	SharedPtr<File> sceneFile = GetSubsystem<ResourceCache>()->GetFile("Scenes/TestScene.xml");
-	scene_->LoadXML(*sceneFile);
+	// Loaded from the XML data rather than the file, so the scene has no file name and clients are not told to load
+	// it: they receive only the replicated content, while the terrain and other local nodes stay on the server
+	XMLFile* xml = GetSubsystem<ResourceCache>()->GetResource<XMLFile>(MAIN_SCENE);
+	if (!xml || !scene_->LoadXML(xml->GetRoot()))
+	{
+		ErrorExit("Could not load " + String(MAIN_SCENE));
+		return;
+	}
 	scene_->SetName("MainScene");
+
+	server_ = new DedicatedServer(context_);
+	server_->SetTickRate(tickRate_);
+	server_->SetInterestRadius(interestRadius_);
+	if (!server_->Start(scene_, serverPort_))
+	{
+		ErrorExit("Could not start the server");
+		return;
+	}
+	server_->SpawnAgents(serverAgents_, NETWORK_BOUNDS);
+}
+
+void FirstApp::StartBots()
+{
+	bots_ = new BotClients(context_);
+	bots_->SetServer(serverAddress_, serverPort_);
+	bots_->SetBounds(NETWORK_BOUNDS);
+	bots_->SetTickRate(tickRate_);
+	bots_->AddBots(numBots_);
+	URHO3D_LOGINFOF("Connecting %u bots to %s:%d", numBots_, serverAddress_.CString(), serverPort_);
+}
+
+void FirstApp::LogNetworkStats()
+{
+	if (server_)
+	{
+		const PODVector<float>& ticks = server_->GetTickTimes();
+		float total = 0.0f;
+		float longest = 0.0f;
+		for (unsigned i = 0; i < ticks.Size(); ++i)
+		{
+			total += ticks[i];
+			longest = Max(longest, ticks[i]);
+		}
+		URHO3D_LOGINFOF("Server: %u clients, %u ticks, tick %.3f ms mean %.3f ms max, %.0f bytes/s, %.1f relevant and "
+			"%.1f replicated nodes per client", server_->GetNumClients(), ticks.Size(),
+			ticks.Size() ? total / ticks.Size() : 0.0f, longest, server_->GetBytesOutPerClient(),
+			server_->GetRelevantNodesPerClient(), server_->GetReplicatedNodesPerClient());
+		server_->ResetStats();
+	}
+	if (bots_)
+	{
+		URHO3D_LOGINFOF("Bots: %u of %u connected, %.0f bytes/s and %.1f replicated nodes per bot",
+			bots_->GetNumConnected(), bots_->GetNumBots(), bots_->GetBytesInPerBot(),
+			bots_->GetReplicatedNodesPerBot());
+	}
+}
+
+void FirstApp::LoadScene()
+{
+	TELEMETRY_SCOPE("scene.load.request");
+	if (!sceneLoader_)
+		sceneLoader_ = new SceneLoader(context_);
+	sceneLoader_->SetTimeBudget(loadTimeBudgetMs_);
+	if (!sceneLoader_->Load(scene_, MAIN_SCENE, asyncLoading_))
+		URHO3D_LOGERROR("Could not load " + String(MAIN_SCENE));
 	//TestScene.loadScene(scene_);
 
 	cameraNode_ = new Node(context_);
 	Camera* camera = cameraNode_->CreateComponent<Camera>();
 	camera->SetFarClip(300.0f);
 	cameraNode_->SetPosition(Vector3(0.0f, 3.0f, -20.0f));
-	SharedPtr<Viewport> viewport(new Viewport(context_, scene_, cameraNode_->GetComponent<Camera>()));
-	GetSubsystem<Renderer>()->SetViewport(0, viewport);
+	// There is no Renderer subsystem when running with EP_HEADLESS
+	Renderer* renderer = GetSubsystem<Renderer>();
+	if (renderer)
+	{
+		SharedPtr<Viewport> viewport(new Viewport(context_, scene_, cameraNode_->GetComponent<Camera>()));
+		renderer->SetViewport(0, viewport);
+	}
+
+	if (!sceneLoader_->IsLoading())
+	{
+		SceneLoaded();
+		return;
+	}
+
+	// Loading screen until the scene is complete
+	ResourceCache* cache = GetSubsystem<ResourceCache>();
+	loadingText_ = GetSubsystem<UI>()->GetRoot()->CreateChild<Text>();
+	loadingText_->SetFont(cache->GetResource<Font>("Fonts/Anonymous Pro.ttf"), 20);
+	loadingText_->SetAlignment(HA_CENTER, VA_CENTER);
+	loadingText_->SetText("Loading scene... 0%");
+	SubscribeToEvent(scene_, E_ASYNCLOADPROGRESS, URHO3D_HANDLER(FirstApp, HandleAsyncLoadProgress));
+	SubscribeToEvent(scene_, E_ASYNCLOADFINISHED, URHO3D_HANDLER(FirstApp, HandleAsyncLoadFinished));
+}
+
+void FirstApp::HandleAsyncLoadProgress(StringHash eventType, VariantMap& eventData)
+{
+	using namespace AsyncLoadProgress;
+
+	if (loadingText_)
+	{
+		int percent = (int)(eventData[P_PROGRESS].GetFloat() * 100.0f);
+		loadingText_->SetText(ToString("Loading scene... %d%% (%d/%d resources, %d/%d nodes)", percent,
+			eventData[P_LOADEDRESOURCES].GetInt(), eventData[P_TOTALRESOURCES].GetInt(),
+			eventData[P_LOADEDNODES].GetInt(), eventData[P_TOTALNODES].GetInt()));
+	}
+}
+
+void FirstApp::HandleAsyncLoadFinished(StringHash eventType, VariantMap& eventData)
+{
+	UnsubscribeFromEvent(scene_, E_ASYNCLOADPROGRESS);
+	UnsubscribeFromEvent(scene_, E_ASYNCLOADFINISHED);
+	if (loadingText_)
+	{
+		loadingText_->Remove();
+		loadingText_.Reset();
+	}
+	SceneLoaded();
+}
+
+void FirstApp::SceneLoaded()
+{
+	scene_->SetName("MainScene");
+
+	// Heightfield collision for the terrain, so physics queries (camera ground clamping) can hit it.
+	// Paged terrain tiles are temporary nodes and get collision from PagedTerrain itself.
+	PODVector<Terrain*> terrains;
+	scene_->GetComponents<Terrain>(terrains, true);
+	for (unsigned i = 0; i < terrains.Size(); ++i)
+	{
+		if (!terrains[i]->GetNode()->IsTemporary())
+			AddTerrainCollision(terrains[i]);
+	}
+
+	// Paged terrain streams around the camera
+	PODVector<PagedTerrain*> pagedTerrains;
+	scene_->GetComponents<PagedTerrain>(pagedTerrains, true);
+	for (unsigned i = 0; i < pagedTerrains.Size(); ++i)
+		pagedTerrains[i]->SetFocusNode(cameraNode_);
+	// Scattered props are activated around the camera
+	PODVector<TerrainScatter*> scatters;
+	scene_->GetComponents<TerrainScatter>(scatters, true);
+	for (unsigned i = 0; i < scatters.Size(); ++i)
+		scatters[i]->SetCamera(cameraNode_->GetComponent<Camera>());
+
+	const SceneLoadStats& stats = sceneLoader_->GetStats();
+	sceneLoadTime_ = stats.wallTime_;
+	Telemetry* telemetry = GetSubsystem<Telemetry>();
+	if (telemetry)
+		telemetry->Record("scene.load", sceneLoadTime_ / 1000.0f);
+	URHO3D_LOGINFOF("Scene loaded (%s, %s) in %.2f ms: %.2f ms on the main thread over %u frames, longest slice %.2f ms, "
+		"%u resources loaded in the background", stats.async_ ? "async" : "sync", stats.snapshot_ ? "snapshot" : "XML",
+		stats.wallTime_ / 1000.0f, stats.mainThreadTime_ / 1000.0f, stats.frames_, stats.longestFrame_ / 1000.0f, stats.resources_);
 }
@@ -3,6 +3,12 @@
 
 #include <Urho3D/Engine/Application.h>
 #include <Urho3D/Input/Input.h>
+#include <Urho3D/UI/Text.h>
+
+#include "bot_clients.h"
+#include "dedicated_server.h"
+#include "physics_queries.h"
+#include "scene_loader.h"
 
 using namespace Urho3D;
 
@@ -17,26 +23,95 @@ public:
 
 	int framecount_;
 	float time_;
+	/// Wall time from LoadScene() until the scene was complete, in microseconds.
+	long long sceneLoadTime_;
+	/// Time from Start() until the end of the first frame, in microseconds.
+	long long timeToFirstFrame_;
+	/// Load the scene in the background behind a loading screen instead of blocking Start().
+	bool asyncLoading_;
+	/// Per-frame time budget for async loading, in milliseconds.
+	int loadTimeBudgetMs_;
+	/// Cache XML scenes as binary snapshots (SceneCache) for faster loads on later launches.
+	bool useSceneCache_;
+	/// Telemetry output file; ".csv" for text, anything else for the compact binary format. Empty (the default)
+	/// disables it.
+	String telemetryFile_;
+	/// Resource package for the main scene, relative to the program directory. "fpbin -package" builds it.
+	String resourcePackage_;
+	/// Mount the resource package ahead of the loose resource directories. Off by default, so a package left over
+	/// from an older build never shadows edited resources.
+	bool useResourcePackage_;
+	/// Build the resource package and exit instead of running.
+	bool buildPackage_;
+	/// Run headless as a dedicated server hosting the scene.
+	bool serverMode_;
+	/// Run headless as this many bot clients of a server, if nonzero.
+	unsigned numBots_;
+	/// Server address for bot clients.
+	String serverAddress_;
+	/// Server port.
+	unsigned short serverPort_;
+	/// Keep the camera above the ground each frame.
+	bool clampCameraToGround_;
+	/// Network updates per second.
+	int tickRate_;
+	/// Radius around each client's observer within which it receives node updates.
+	float interestRadius_;
+	/// Number of replicated agents the server simulates.
+	unsigned serverAgents_;
 	SharedPtr<Scene> scene_;
 	SharedPtr<Node> cameraNode_;
+	SharedPtr<SceneLoader> sceneLoader_;
+	SharedPtr<PhysicsQueryBatch> physicsQueries_;
+	SharedPtr<DedicatedServer> server_;
+	SharedPtr<BotClients> bots_;
 
 	virtual void Setup();
 	virtual void Start();
 	virtual void Stop();
 
 protected:
-	
+	// Load the scene
+	void LoadScene();
+	// Return full path of the resource package, or empty if disabled
+	String GetResourcePackagePath() const;
+	// Mount the resource package if it exists
+	void MountResourcePackage();
+	// Write the resource package for the main scene
+	bool BuildResourcePackage();
+	// Handle frame end
+	virtual void HandleEndFrame(StringHash eventType, VariantMap& eventData);
+
 private:
+	// Started at the beginning of Start()
+	HiresTimer startTimer_;
+	// Loading screen text, shown while the scene loads asynchronously
+	SharedPtr<Text> loadingText_;
+	// Camera ground probe, reused every frame
+	PODVector<Vector3> groundProbes_;
+	PODVector<float> groundHeights_;
+
+	// Finish scene setup once loading is complete
+	void SceneLoaded();
+	// Keep the camera above the terrain
+	void ClampCameraToGround();
+	// Load the scene and serve it to network clients
+	void StartServer();
+	// Connect bot clients to a server
+	void StartBots();
+	// Log server or bot statistics for the last second
+	void LogNetworkStats();
 
-	
 	// Handle key down event
 	void HandleKeyDown(StringHash eventType, VariantMap& eventData);
 	// Handle key up event
 	void HandleKeyUp(StringHash eventType, VariantMap& eventData);
 	// Handle update
 	void HandleUpdate(StringHash eventType, VariantMap& eventData);
-	// Load the scene
-	void LoadScene();
+	// Handle async scene load progress
+	void HandleAsyncLoadProgress(StringHash eventType, VariantMap& eventData);
+	// Handle async scene load completion
+	void HandleAsyncLoadFinished(StringHash eventType, VariantMap& eventData);
 };
 
 #endif
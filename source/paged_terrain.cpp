@@ -0,0 +1,644 @@
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/StringUtils.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/Graphics/Material.h>
+#include <Urho3D/Graphics/Terrain.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Physics/CollisionShape.h>
+#include <Urho3D/Physics/RigidBody.h>
+#include <Urho3D/Resource/Image.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Scene/Node.h>
+
+#include "paged_terrain.h"
+#include "physics_queries.h"
+#include "telemetry.h"
+
+using namespace Urho3D;
+
+// Copy (samples x samples) heights, every step'th pixel from (originX, originY), into dest in Terrain's 3-byte layout.
+// 1-2 channel images hold 8-bit heights; with 3 or more channels red and green are the high and low bytes.
+static void SampleImage(const Image* image, int originX, int originY, int samples, int step,
+	PODVector<unsigned char>& dest)
+{
+	const unsigned char* src = image->GetData();
+	const int width = image->GetWidth();
+	const int height = image->GetHeight();
+	const unsigned components = image->GetComponents();
+
+	dest.Resize((unsigned)(samples * samples * 3));
+	unsigned char* out = &dest[0];
+	for (int y = 0; y < samples; ++y)
+	{
+		const int sy = Clamp(originY + y * step, 0, height - 1);
+		for (int x = 0; x < samples; ++x)
+		{
+			const int sx = Clamp(originX + x * step, 0, width - 1);
+			const unsigned char* pixel = src + (sy * width + sx) * components;
+			*out++ = pixel[0];
+			*out++ = components >= 3 ? pixel[1] : 0;
+			*out++ = 0;
+		}
+	}
+}
+
+// Replace the heights along the four edges of a (samples x samples) tile in Terrain's 3-byte layout with linear
+// interpolation between every edgeStep'th edge sample. With edgeStep chosen so that all LODs land on the coarsest
+// LOD's samples, adjacent tiles at any LODs share identical edges and cannot crack.
+static void SnapTileEdges(PODVector<unsigned char>& data, int samples, int edgeStep)
+{
+	if (edgeStep <= 1 || data.Size() < (unsigned)(samples * samples * 3))
+		return;
+
+	unsigned char* base = &data[0];
+	// Start sample and stride between samples, both in samples, of the rows y = 0 and y = last, then the columns
+	const int starts[4] = { 0, (samples - 1) * samples, 0, samples - 1 };
+	const int strides[4] = { 1, 1, samples, samples };
+	for (unsigned edge = 0; edge < 4; ++edge)
+	{
+		for (int i = 0; i < samples - 1; i += edgeStep)
+		{
+			unsigned char* a = base + (starts[edge] + i * strides[edge]) * 3;
+			unsigned char* b = base + (starts[edge] + (i + edgeStep) * strides[edge]) * 3;
+			const int heightA = (a[0] << 8) | a[1];
+			const int heightB = (b[0] << 8) | b[1];
+			for (int j = 1; j < edgeStep; ++j)
+			{
+				unsigned char* out = base + (starts[edge] + (i + j) * strides[edge]) * 3;
+				const int height = heightA + (heightB - heightA) * j / edgeStep;
+				out[0] = (unsigned char)(height >> 8);
+				out[1] = (unsigned char)(height & 0xff);
+			}
+		}
+	}
+}
+
+ImageTerrainSource::ImageTerrainSource(Image* image) :
+	image_(image)
+{
+}
+
+IntVector2 ImageTerrainSource::GetSize() const
+{
+	return image_ ? IntVector2(image_->GetWidth(), image_->GetHeight()) : IntVector2::ZERO;
+}
+
+bool ImageTerrainSource::ReadTile(int tileX, int tileY, int tileSize, int step, PODVector<unsigned char>& dest) const
+{
+	if (!image_ || image_->IsCompressed() || !image_->GetData())
+		return false;
+	SampleImage(image_, tileX * tileSize, tileY * tileSize, tileSize / step + 1, step, dest);
+	return true;
+}
+
+TileFileTerrainSource::TileFileTerrainSource(Context* context, const String& directory, const IntVector2& size,
+	int tileSize) :
+	context_(context),
+	directory_(AddTrailingSlash(directory)),
+	size_(size),
+	tileSize_(tileSize)
+{
+}
+
+bool TileFileTerrainSource::ReadTile(int tileX, int tileY, int tileSize, int step, PODVector<unsigned char>& dest) const
+{
+	if (tileSize != tileSize_)
+		return false;
+
+	File file(context_, directory_ + ToString("%d_%d.png", tileX, tileY));
+	if (!file.IsOpen())
+		return false;
+	Image image(context_);
+	if (!image.Load(file) || image.GetWidth() != tileSize_ + 1 || image.GetHeight() != tileSize_ + 1)
+		return false;
+	SampleImage(&image, 0, 0, tileSize / step + 1, step, dest);
+	return true;
+}
+
+SyntheticTerrainSource::SyntheticTerrainSource(const IntVector2& size, unsigned seed) :
+	size_(size),
+	seed_(seed)
+{
+}
+
+// Integer hash of a lattice point to [0, 1)
+static inline float LatticeValue(int x, int y, unsigned seed)
+{
+	unsigned h = (unsigned)x * 0x8da6b343u ^ (unsigned)y * 0xd8163841u ^ seed * 0xcb1ab31fu;
+	h ^= h >> 13;
+	h *= 0x5bd1e995u;
+	h ^= h >> 15;
+	return (h & 0xffffff) / 16777216.0f;
+}
+
+// Bilinearly interpolated value noise with smoothstep weights
+static inline float ValueNoise(float x, float y, unsigned seed)
+{
+	int ix = FloorToInt(x);
+	int iy = FloorToInt(y);
+	float fx = x - ix;
+	float fy = y - iy;
+	fx = fx * fx * (3.0f - 2.0f * fx);
+	fy = fy * fy * (3.0f - 2.0f * fy);
+	float a = Lerp(LatticeValue(ix, iy, seed), LatticeValue(ix + 1, iy, seed), fx);
+	float b = Lerp(LatticeValue(ix, iy + 1, seed), LatticeValue(ix + 1, iy + 1, seed), fx);
+	return Lerp(a, b, fy);
+}
+
+unsigned short SyntheticTerrainSource::GetHeight(int x, int y) const
+{
+	// Eight octaves starting at a 2048-sample wavelength
+	float frequency = 1.0f / 2048.0f;
+	float amplitude = 0.5f;
+	float height = 0.0f;
+	for (unsigned octave = 0; octave < 8; ++octave)
+	{
+		height += amplitude * ValueNoise(x * frequency, y * frequency, seed_ + octave);
+		frequency *= 2.0f;
+		amplitude *= 0.5f;
+	}
+	return (unsigned short)(Clamp(height, 0.0f, 1.0f) * 65535.0f);
+}
+
+bool SyntheticTerrainSource::ReadTile(int tileX, int tileY, int tileSize, int step, PODVector<unsigned char>& dest) const
+{
+	const int samples = tileSize / step + 1;
+	dest.Resize((unsigned)(samples * samples * 3));
+	unsigned char* out = &dest[0];
+	for (int y = 0; y < samples; ++y)
+	{
+		const int sy = Clamp(tileY * tileSize + y * step, 0, size_.y_ - 1);
+		for (int x = 0; x < samples; ++x)
+		{
+			const int sx = Clamp(tileX * tileSize + x * step, 0, size_.x_ - 1);
+			unsigned short height = GetHeight(sx, sy);
+			*out++ = (unsigned char)(height >> 8);
+			*out++ = (unsigned char)(height & 0xff);
+			*out++ = 0;
+		}
+	}
+	return true;
+}
+
+bool SplitHeightmap(Image* image, int tileSize, const String& directory)
+{
+	if (!image || image->IsCompressed() || tileSize <= 0)
+		return false;
+
+	Context* context = image->GetContext();
+	String path = AddTrailingSlash(directory);
+	context->GetSubsystem<FileSystem>()->CreateDir(path);
+
+	const int tilesX = (image->GetWidth() - 2) / tileSize + 1;
+	const int tilesY = (image->GetHeight() - 2) / tileSize + 1;
+	PODVector<unsigned char> data;
+	for (int y = 0; y < tilesY; ++y)
+	{
+		for (int x = 0; x < tilesX; ++x)
+		{
+			SampleImage(image, x * tileSize, y * tileSize, tileSize + 1, 1, data);
+			Image tile(context);
+			tile.SetSize(tileSize + 1, tileSize + 1, 3);
+			tile.SetData(&data[0]);
+			if (!tile.SavePNG(path + ToString("%d_%d.png", x, y)))
+				return false;
+		}
+	}
+	return true;
+}
+
+PagedTerrain::PagedTerrain(Context* context) :
+	LogicComponent(context),
+	heightMapRef_(Image::GetTypeStatic()),
+	spacing_(1.0f, 0.25f, 1.0f),
+	tileSize_(128),
+	viewRadius_(4),
+	lodRadius_(2),
+	maxLodLevels_(3),
+	buildBudget_(2.0f),
+	collision_(false),
+	tilesBuilt_(0),
+	tilesUnloaded_(0)
+{
+	SetUpdateEventMask(USE_UPDATE);
+}
+
+PagedTerrain::~PagedTerrain()
+{
+	ClearTiles();
+}
+
+void PagedTerrain::RegisterObject(Context* context)
+{
+	context->RegisterFactory<PagedTerrain>();
+
+	URHO3D_ACCESSOR_ATTRIBUTE("Is Enabled", IsEnabled, SetEnabled, bool, true, AM_DEFAULT);
+	URHO3D_MIXED_ACCESSOR_ATTRIBUTE("Height Map", GetHeightMapAttr, SetHeightMapAttr, ResourceRef,
+		ResourceRef(Image::GetTypeStatic()), AM_DEFAULT);
+	URHO3D_MIXED_ACCESSOR_ATTRIBUTE("Material", GetMaterialAttr, SetMaterialAttr, ResourceRef,
+		ResourceRef(Material::GetTypeStatic()), AM_DEFAULT);
+	URHO3D_ACCESSOR_ATTRIBUTE("Vertex Spacing", GetSpacing, SetSpacing, Vector3, Vector3(1.0f, 0.25f, 1.0f), AM_DEFAULT);
+	URHO3D_ACCESSOR_ATTRIBUTE("Tile Size", GetTileSize, SetTileSize, int, 128, AM_DEFAULT);
+	URHO3D_ACCESSOR_ATTRIBUTE("View Radius", GetViewRadius, SetViewRadius, int, 4, AM_DEFAULT);
+	URHO3D_ACCESSOR_ATTRIBUTE("LOD Radius", GetLodRadius, SetLodRadius, int, 2, AM_DEFAULT);
+	URHO3D_ACCESSOR_ATTRIBUTE("Max LOD Levels", GetMaxLodLevels, SetMaxLodLevels, int, 3, AM_DEFAULT);
+	URHO3D_ACCESSOR_ATTRIBUTE("Collision", GetCollision, SetCollision, bool, false, AM_DEFAULT);
+}
+
+void PagedTerrain::SetSource(TerrainTileSource* source)
+{
+	ClearTiles();
+	source_ = source;
+	tilesBuilt_ = 0;
+	tilesUnloaded_ = 0;
+}
+
+void PagedTerrain::SetFocusNode(Node* node)
+{
+	focusNode_ = node;
+}
+
+void PagedTerrain::SetMaterial(Material* material)
+{
+	material_ = material;
+	for (HashMap<IntVector2, Tile>::Iterator i = tiles_.Begin(); i != tiles_.End(); ++i)
+	{
+		if (i->second_.terrain_)
+			i->second_.terrain_->SetMaterial(material);
+	}
+}
+
+Material* PagedTerrain::GetMaterial() const
+{
+	return material_;
+}
+
+void PagedTerrain::SetSpacing(const Vector3& spacing)
+{
+	if (spacing == spacing_)
+		return;
+	ClearTiles();
+	spacing_ = spacing;
+}
+
+void PagedTerrain::SetTileSize(int tileSize)
+{
+	tileSize = Clamp((int)NextPowerOfTwo((unsigned)Max(tileSize, 4)), 4, 1024);
+	if (tileSize == tileSize_)
+		return;
+	ClearTiles();
+	tileSize_ = tileSize;
+}
+
+void PagedTerrain::SetViewRadius(int radius)
+{
+	viewRadius_ = Max(radius, 0);
+}
+
+void PagedTerrain::SetLodRadius(int radius)
+{
+	lodRadius_ = Max(radius, 1);
+}
+
+void PagedTerrain::SetMaxLodLevels(int levels)
+{
+	maxLodLevels_ = Clamp(levels, 1, 8);
+}
+
+void PagedTerrain::SetCollision(bool enable)
+{
+	if (enable == collision_)
+		return;
+	collision_ = enable;
+	for (HashMap<IntVector2, Tile>::Iterator i = tiles_.Begin(); i != tiles_.End(); ++i)
+	{
+		Node* tileNode = i->second_.node_;
+		if (!tileNode)
+			continue;
+		if (enable)
+			AddTerrainCollision(i->second_.terrain_);
+		else
+		{
+			tileNode->RemoveComponent<CollisionShape>();
+			tileNode->RemoveComponent<RigidBody>();
+		}
+	}
+}
+
+void PagedTerrain::SetHeightMapAttr(const ResourceRef& value)
+{
+	heightMapRef_ = value;
+	Image* image = value.name_.Empty() ? 0 : GetSubsystem<ResourceCache>()->GetResource<Image>(value.name_);
+	SetSource(image ? new ImageTerrainSource(image) : 0);
+}
+
+void PagedTerrain::SetMaterialAttr(const ResourceRef& value)
+{
+	SetMaterial(GetSubsystem<ResourceCache>()->GetResource<Material>(value.name_));
+}
+
+ResourceRef PagedTerrain::GetHeightMapAttr() const
+{
+	return heightMapRef_;
+}
+
+ResourceRef PagedTerrain::GetMaterialAttr() const
+{
+	return GetResourceRef(material_, Material::GetTypeStatic());
+}
+
+float PagedTerrain::GetHeight(const Vector3& worldPosition) const
+{
+	if (!node_ || !source_)
+		return 0.0f;
+	IntVector2 tile = GetTileAt(node_->GetWorldTransform().Inverse() * worldPosition);
+	HashMap<IntVector2, Tile>::ConstIterator i = tiles_.Find(tile);
+	if (i == tiles_.End() || !i->second_.terrain_)
+		return 0.0f;
+	return i->second_.terrain_->GetHeight(worldPosition);
+}
+
+int PagedTerrain::GetDesiredLod(const IntVector2& tile, const IntVector2& focus) const
+{
+	int distance = Max(Abs(tile.x_ - focus.x_), Abs(tile.y_ - focus.y_));
+	return Min(distance / lodRadius_, GetCoarsestLod());
+}
+
+int PagedTerrain::GetCoarsestLod() const
+{
+	int lod = maxLodLevels_ - 1;
+	// Terrain needs at least 4 quads per side
+	while (lod > 0 && (tileSize_ >> lod) < 4)
+		--lod;
+	return lod;
+}
+
+IntVector2 PagedTerrain::GetTileAt(const Vector3& localPosition) const
+{
+	const IntVector2 size = source_->GetSize();
+	float x = localPosition.x_ / spacing_.x_ + (size.x_ - 1) * 0.5f;
+	// Image rows run towards -Z, as in Terrain
+	float y = (size.y_ - 1) * 0.5f - localPosition.z_ / spacing_.z_;
+	return IntVector2(FloorToInt(x / tileSize_), FloorToInt(y / tileSize_));
+}
+
+Vector3 PagedTerrain::GetTileCenter(const IntVector2& tile) const
+{
+	const IntVector2 size = source_->GetSize();
+	return Vector3(((tile.x_ + 0.5f) * tileSize_ - (size.x_ - 1) * 0.5f) * spacing_.x_, 0.0f,
+		((size.y_ - 1) * 0.5f - (tile.y_ + 0.5f) * tileSize_) * spacing_.z_);
+}
+
+void PagedTerrain::Update(float timeStep)
+{
+	if (!source_ || !node_)
+		return;
+	TELEMETRY_SCOPE("terrain.update");
+
+	WorkQueue* queue = GetSubsystem<WorkQueue>();
+	const IntVector2 size = source_->GetSize();
+	const IntVector2 numTiles((size.x_ - 2) / tileSize_ + 1, (size.y_ - 2) / tileSize_ + 1);
+	Vector3 focusPosition = focusNode_ ? node_->GetWorldTransform().Inverse() * focusNode_->GetWorldPosition() :
+		Vector3::ZERO;
+	const IntVector2 focus = GetTileAt(focusPosition);
+
+	// Collect reads finished by the worker threads
+	{
+		MutexLock lock(completedMutex_);
+		ready_.Push(completed_);
+		completed_.Clear();
+	}
+
+	// Build geometry for finished reads, nearest first, within the time budget. At least one per frame so the
+	// terrain always makes progress
+	HiresTimer buildTimer;
+	while (!ready_.Empty())
+	{
+		unsigned nearest = 0;
+		int nearestDistance = M_MAX_INT;
+		for (unsigned i = 0; i < ready_.Size(); ++i)
+		{
+			IntVector2 delta = ready_[i]->tile_ - focus;
+			int distance = Max(Abs(delta.x_), Abs(delta.y_));
+			if (distance < nearestDistance)
+			{
+				nearest = i;
+				nearestDistance = distance;
+			}
+		}
+		TileRequest* request = ready_[nearest];
+		ready_.EraseSwap(nearest);
+		pending_.Erase(request->tile_);
+
+		// Skip reads for tiles that left the view or changed detail level meanwhile
+		if (request->success_ && nearestDistance <= viewRadius_ && request->lod_ == GetDesiredLod(request->tile_, focus))
+			BuildTile(request);
+		delete request;
+
+		if (buildTimer.GetUSec(false) >= (long long)(buildBudget_ * 1000.0f))
+			break;
+	}
+
+	// Unload tiles that left the view, and cancel reads for them that have not started yet
+	for (HashMap<IntVector2, Tile>::Iterator i = tiles_.Begin(); i != tiles_.End();)
+	{
+		IntVector2 delta = i->first_ - focus;
+		if (Max(Abs(delta.x_), Abs(delta.y_)) > viewRadius_)
+		{
+			UnlinkNeighbors(i->first_);
+			if (i->second_.node_)
+				i->second_.node_->Remove();
+			i = tiles_.Erase(i);
+			++tilesUnloaded_;
+		}
+		else
+			++i;
+	}
+	for (HashMap<IntVector2, TileRequest*>::Iterator i = pending_.Begin(); i != pending_.End();)
+	{
+		IntVector2 delta = i->first_ - focus;
+		if (Max(Abs(delta.x_), Abs(delta.y_)) > viewRadius_ && queue->RemoveWorkItem(i->second_->item_))
+		{
+			delete i->second_;
+			i = pending_.Erase(i);
+		}
+		else
+			++i;
+	}
+
+	// Request missing tiles and detail level changes, in rings around the focus tile so the nearest come first
+	for (int ring = 0; ring <= viewRadius_; ++ring)
+	{
+		for (int y = focus.y_ - ring; y <= focus.y_ + ring; ++y)
+		{
+			for (int x = focus.x_ - ring; x <= focus.x_ + ring; ++x)
+			{
+				if (Max(Abs(x - focus.x_), Abs(y - focus.y_)) != ring)
+					continue;
+				if (x < 0 || y < 0 || x >= numTiles.x_ || y >= numTiles.y_)
+					continue;
+
+				IntVector2 tile(x, y);
+				if (pending_.Contains(tile))
+					continue;
+				int lod = GetDesiredLod(tile, focus);
+				HashMap<IntVector2, Tile>::ConstIterator i = tiles_.Find(tile);
+				if (i == tiles_.End() || i->second_.lod_ != lod)
+					RequestTile(tile, lod);
+			}
+		}
+	}
+}
+
+void PagedTerrain::RequestTile(const IntVector2& tile, int lod)
+{
+	WorkQueue* queue = GetSubsystem<WorkQueue>();
+
+	TileRequest* request = new TileRequest();
+	request->owner_ = this;
+	request->tile_ = tile;
+	request->lod_ = lod;
+	request->source_ = source_;
+	request->tileSize_ = tileSize_;
+	request->edgeStep_ = 1 << (GetCoarsestLod() - lod);
+	request->success_ = false;
+
+	// Not taken from the WorkQueue pool: a pooled item could be handed to someone else once it completes while
+	// this request still refers to it
+	SharedPtr<WorkItem> item(new WorkItem());
+	item->workFunction_ = ReadTileWork;
+	item->aux_ = request;
+	// Below the engine's own per-frame work, which uses M_MAX_UNSIGNED
+	item->priority_ = (unsigned)(viewRadius_ - Min(lod * lodRadius_, viewRadius_));
+	request->item_ = item;
+	pending_[tile] = request;
+	queue->AddWorkItem(item);
+}
+
+void PagedTerrain::ReadTileWork(const WorkItem* item, unsigned threadIndex)
+{
+	TileRequest* request = reinterpret_cast<TileRequest*>(item->aux_);
+	request->success_ = request->source_->ReadTile(request->tile_.x_, request->tile_.y_, request->tileSize_,
+		1 << request->lod_, request->data_);
+	if (request->success_)
+		SnapTileEdges(request->data_, request->tileSize_ / (1 << request->lod_) + 1, request->edgeStep_);
+
+	MutexLock lock(request->owner_->completedMutex_);
+	request->owner_->completed_.Push(request);
+}
+
+void PagedTerrain::BuildTile(TileRequest* request)
+{
+	TELEMETRY_SCOPE("terrain.build");
+
+	const int step = 1 << request->lod_;
+	const int samples = tileSize_ / step + 1;
+	SharedPtr<Image> image(new Image(context_));
+	image->SetSize(samples, samples, 3);
+	image->SetData(&request->data_[0]);
+
+	// The new tile is built next to the old one, which is removed only once the replacement exists
+	Node* tileNode = node_->CreateChild(ToString("Tile_%d_%d", request->tile_.x_, request->tile_.y_), LOCAL);
+	tileNode->SetTemporary(true);
+	tileNode->SetPosition(GetTileCenter(request->tile_));
+	Terrain* terrain = tileNode->CreateComponent<Terrain>(LOCAL);
+	terrain->SetPatchSize(Min(32, samples - 1));
+	terrain->SetSpacing(Vector3(spacing_.x_ * step, spacing_.y_, spacing_.z_ * step));
+	// Patch LOD must not drop the edge vertices shared with tiles at the coarsest level, see SnapTileEdges()
+	terrain->SetMaxLodLevels((unsigned)(GetCoarsestLod() - request->lod_ + 1));
+	terrain->SetMaterial(material_);
+	terrain->SetHeightMap(image);
+	if (collision_)
+		AddTerrainCollision(terrain);
+
+	Tile& tile = tiles_[request->tile_];
+	if (tile.node_)
+		tile.node_->Remove();
+	tile.node_ = tileNode;
+	tile.terrain_ = terrain;
+	tile.lod_ = request->lod_;
+	LinkNeighbors(request->tile_);
+	++tilesBuilt_;
+}
+
+Terrain* PagedTerrain::GetTileTerrain(const IntVector2& tile) const
+{
+	HashMap<IntVector2, Tile>::ConstIterator i = tiles_.Find(tile);
+	return i != tiles_.End() ? i->second_.terrain_.Get() : 0;
+}
+
+void PagedTerrain::LinkNeighbors(const IntVector2& tile)
+{
+	Terrain* terrain = GetTileTerrain(tile);
+	if (!terrain)
+		return;
+	const int lod = tiles_[tile].lod_;
+
+	// Tile rows run towards -Z, so north is the previous row
+	const IntVector2 offsets[4] = { IntVector2(0, -1), IntVector2(0, 1), IntVector2(-1, 0), IntVector2(1, 0) };
+	Terrain* linked[4];
+	for (unsigned i = 0; i < 4; ++i)
+	{
+		const IntVector2 neighborTile = tile + offsets[i];
+		Terrain* neighbor = GetTileTerrain(neighborTile);
+		// Only tiles at the same LOD share a patch layout that Terrain can stitch across. Seams between LODs are
+		// closed by SnapTileEdges() instead
+		linked[i] = neighbor && tiles_[neighborTile].lod_ == lod ? neighbor : 0;
+		if (!neighbor)
+			continue;
+		// Link back, or drop a link the neighbor held to the tile this one replaced
+		switch (i)
+		{
+		case 0: neighbor->SetSouthNeighbor(linked[i] ? terrain : 0); break;
+		case 1: neighbor->SetNorthNeighbor(linked[i] ? terrain : 0); break;
+		case 2: neighbor->SetEastNeighbor(linked[i] ? terrain : 0); break;
+		case 3: neighbor->SetWestNeighbor(linked[i] ? terrain : 0); break;
+		}
+	}
+	terrain->SetNeighbors(linked[0], linked[1], linked[2], linked[3]);
+}
+
+void PagedTerrain::UnlinkNeighbors(const IntVector2& tile)
+{
+	if (Terrain* neighbor = GetTileTerrain(IntVector2(tile.x_, tile.y_ - 1)))
+		neighbor->SetSouthNeighbor(0);
+	if (Terrain* neighbor = GetTileTerrain(IntVector2(tile.x_, tile.y_ + 1)))
+		neighbor->SetNorthNeighbor(0);
+	if (Terrain* neighbor = GetTileTerrain(IntVector2(tile.x_ - 1, tile.y_)))
+		neighbor->SetEastNeighbor(0);
+	if (Terrain* neighbor = GetTileTerrain(IntVector2(tile.x_ + 1, tile.y_)))
+		neighbor->SetWestNeighbor(0);
+}
+
+void PagedTerrain::ClearTiles()
+{
+	// Reads still queued are removed; reads already running on a worker are waited for
+	WorkQueue* queue = GetSubsystem<WorkQueue>();
+	for (HashMap<IntVector2, TileRequest*>::Iterator i = pending_.Begin(); i != pending_.End(); ++i)
+	{
+		TileRequest* request = i->second_;
+		if (queue && !queue->RemoveWorkItem(request->item_))
+		{
+			while (!request->item_->completed_)
+				Time::Sleep(0);
+		}
+		delete request;
+	}
+	pending_.Clear();
+	// Everything in ready_ and completed_ was also in pending_ and has been deleted
+	ready_.Clear();
+	{
+		MutexLock lock(completedMutex_);
+		completed_.Clear();
+	}
+
+	for (HashMap<IntVector2, Tile>::Iterator i = tiles_.Begin(); i != tiles_.End(); ++i)
+	{
+		if (i->second_.node_)
+			i->second_.node_->Remove();
+	}
+	tiles_.Clear();
+}
@@ -0,0 +1,220 @@
+#ifndef PAGED_TERRAIN_H
+#define PAGED_TERRAIN_H
+
+#include <Urho3D/Container/HashMap.h>
+#include <Urho3D/Core/Mutex.h>
+#include <Urho3D/Math/Vector2.h>
+#include <Urho3D/Math/Vector3.h>
+#include <Urho3D/Scene/LogicComponent.h>
+
+using namespace Urho3D;
+
+namespace Urho3D
+{
+	class Image;
+	class Material;
+	class Terrain;
+	class WorkItem;
+}
+
+/// Provider of heightfield samples for PagedTerrain. Heights are 16-bit. ReadTile() is called from worker threads
+/// and must not touch the scene or other shared engine state.
+class TerrainTileSource : public RefCounted
+{
+public:
+	/// Return size of the whole heightfield in samples.
+	virtual IntVector2 GetSize() const = 0;
+	/// Fill dest with (tileSize / step + 1)^2 samples of the tile at (tileX, tileY), taking every step'th sample.
+	/// Samples are 3 bytes (height high byte, low byte, 0) in the layout Terrain expects from a heightmap image.
+	/// Samples outside the heightfield are clamped to its edge. Returns false on failure.
+	virtual bool ReadTile(int tileX, int tileY, int tileSize, int step, PODVector<unsigned char>& dest) const = 0;
+};
+
+/// Tile source backed by a heightmap image held in memory. Suited to heightmaps that fit comfortably in memory.
+class ImageTerrainSource : public TerrainTileSource
+{
+public:
+	ImageTerrainSource(Image* image);
+
+	virtual IntVector2 GetSize() const;
+	virtual bool ReadTile(int tileX, int tileY, int tileSize, int step, PODVector<unsigned char>& dest) const;
+
+private:
+	SharedPtr<Image> image_;
+};
+
+/// Tile source reading pre-split tiles "<x>_<y>.png" from a directory, as written by SplitHeightmap(). Only the tiles
+/// near the camera are ever read, so memory use does not depend on the heightfield size.
+class TileFileTerrainSource : public TerrainTileSource
+{
+public:
+	TileFileTerrainSource(Context* context, const String& directory, const IntVector2& size, int tileSize);
+
+	virtual IntVector2 GetSize() const { return size_; }
+	virtual bool ReadTile(int tileX, int tileY, int tileSize, int step, PODVector<unsigned char>& dest) const;
+
+private:
+	Context* context_;
+	String directory_;
+	IntVector2 size_;
+	int tileSize_;
+};
+
+/// Deterministic fractal noise heightfield of any size, generated on demand.
+class SyntheticTerrainSource : public TerrainTileSource
+{
+public:
+	SyntheticTerrainSource(const IntVector2& size, unsigned seed = 1);
+
+	virtual IntVector2 GetSize() const { return size_; }
+	virtual bool ReadTile(int tileX, int tileY, int tileSize, int step, PODVector<unsigned char>& dest) const;
+
+	/// Return 16-bit height at a sample position.
+	unsigned short GetHeight(int x, int y) const;
+
+private:
+	IntVector2 size_;
+	unsigned seed_;
+};
+
+/// Split a heightmap image into (tileSize + 1)^2 tiles "<x>_<y>.png" in directory for TileFileTerrainSource.
+bool SplitHeightmap(Image* image, int tileSize, const String& directory);
+
+/// Terrain paged in square tiles around a focus node (normally the camera). Each tile is a child node with its own
+/// Terrain component. Tile heights are read on WorkQueue threads; at most (2 * viewRadius + 1)^2 tiles are
+/// resident, so memory use is fixed by the view radius rather than the heightfield size. Tiles further than
+/// lodRadius tiles away use every 2nd sample, further than 2 * lodRadius every 4th, and so on. Tile edges follow the
+/// coarsest level's samples and tiles at the same level are linked as Terrain neighbors, so there are no cracks at
+/// tile or LOD seams. Turning finished tiles into geometry happens on the main thread under a per-frame time budget.
+class PagedTerrain : public LogicComponent
+{
+	URHO3D_OBJECT(PagedTerrain, LogicComponent);
+
+public:
+	/// Construct.
+	PagedTerrain(Context* context);
+	/// Destruct. Waits for tile reads in flight.
+	virtual ~PagedTerrain();
+	/// Register object factory and attributes.
+	static void RegisterObject(Context* context);
+
+	/// Per-frame tile streaming.
+	virtual void Update(float timeStep);
+
+	/// Set the heightfield source. Resident tiles are discarded.
+	void SetSource(TerrainTileSource* source);
+	/// Set node whose position drives which tiles are resident.
+	void SetFocusNode(Node* node);
+	/// Set material for the tiles.
+	void SetMaterial(Material* material);
+	/// Set distance between samples; Y is the height of one 8-bit height step.
+	void SetSpacing(const Vector3& spacing);
+	/// Set tile size in samples. Must be a power of two.
+	void SetTileSize(int tileSize);
+	/// Set how many tiles around the focus tile are resident.
+	void SetViewRadius(int radius);
+	/// Set width in tiles of each level of detail ring.
+	void SetLodRadius(int radius);
+	/// Set the coarsest level of detail; level n uses every 2^n'th sample.
+	void SetMaxLodLevels(int levels);
+	/// Set per-frame time budget in milliseconds for building tile geometry.
+	void SetBuildBudget(float milliseconds) { buildBudget_ = milliseconds; }
+	/// Set whether tiles get heightfield collision (see AddTerrainCollision()). Coarse tiles collide at their LOD.
+	void SetCollision(bool enable);
+
+	TerrainTileSource* GetSource() const { return source_; }
+	Material* GetMaterial() const;
+	const Vector3& GetSpacing() const { return spacing_; }
+	int GetTileSize() const { return tileSize_; }
+	int GetViewRadius() const { return viewRadius_; }
+	int GetLodRadius() const { return lodRadius_; }
+	int GetMaxLodLevels() const { return maxLodLevels_; }
+	bool GetCollision() const { return collision_; }
+	/// Return number of tiles with geometry.
+	unsigned GetNumResidentTiles() const { return tiles_.Size(); }
+	/// Return number of tile reads queued or running.
+	unsigned GetNumPendingTiles() const { return pending_.Size(); }
+	/// Return total tile builds and unloads since the source was set.
+	unsigned GetNumTilesBuilt() const { return tilesBuilt_; }
+	unsigned GetNumTilesUnloaded() const { return tilesUnloaded_; }
+	/// Return height at a world position from resident tiles, or 0 if the position is not resident.
+	float GetHeight(const Vector3& worldPosition) const;
+
+	/// Set height map attribute; uses an ImageTerrainSource.
+	void SetHeightMapAttr(const ResourceRef& value);
+	/// Set material attribute.
+	void SetMaterialAttr(const ResourceRef& value);
+	ResourceRef GetHeightMapAttr() const;
+	ResourceRef GetMaterialAttr() const;
+
+private:
+	/// Resident tile.
+	struct Tile
+	{
+		WeakPtr<Node> node_;
+		WeakPtr<Terrain> terrain_;
+		int lod_;
+	};
+
+	/// Tile read in flight. Written by one worker thread, then handed back to the main thread.
+	struct TileRequest
+	{
+		PagedTerrain* owner_;
+		IntVector2 tile_;
+		int lod_;
+		SharedPtr<TerrainTileSource> source_;
+		int tileSize_;
+		int edgeStep_;
+		PODVector<unsigned char> data_;
+		bool success_;
+		SharedPtr<WorkItem> item_;
+	};
+
+	SharedPtr<TerrainTileSource> source_;
+	WeakPtr<Node> focusNode_;
+	SharedPtr<Material> material_;
+	ResourceRef heightMapRef_;
+	Vector3 spacing_;
+	int tileSize_;
+	int viewRadius_;
+	int lodRadius_;
+	int maxLodLevels_;
+	float buildBudget_;
+	bool collision_;
+
+	HashMap<IntVector2, Tile> tiles_;
+	HashMap<IntVector2, TileRequest*> pending_;
+	// Requests finished by worker threads, guarded by completedMutex_
+	PODVector<TileRequest*> completed_;
+	Mutex completedMutex_;
+	// Finished requests waiting for geometry to be built, main thread only
+	PODVector<TileRequest*> ready_;
+	unsigned tilesBuilt_;
+	unsigned tilesUnloaded_;
+
+	// Return level of detail for a tile given the focus tile
+	int GetDesiredLod(const IntVector2& tile, const IntVector2& focus) const;
+	// Return the coarsest level of detail the tile size allows
+	int GetCoarsestLod() const;
+	// Return tile under a position in the node's local space
+	IntVector2 GetTileAt(const Vector3& localPosition) const;
+	// Return centre of a tile in the node's local space
+	Vector3 GetTileCenter(const IntVector2& tile) const;
+	// Queue a tile read on the WorkQueue
+	void RequestTile(const IntVector2& tile, int lod);
+	// Build geometry for a finished tile read
+	void BuildTile(TileRequest* request);
+	// Return a resident tile's Terrain, or null
+	Terrain* GetTileTerrain(const IntVector2& tile) const;
+	// Link a tile's Terrain with its resident neighbors at the same LOD, and update their links back to it
+	void LinkNeighbors(const IntVector2& tile);
+	// Clear the neighbors' links to a tile that is being unloaded
+	void UnlinkNeighbors(const IntVector2& tile);
+	// Discard all tiles and wait for reads in flight
+	void ClearTiles();
+
+	// Worker thread entry point
+	static void ReadTileWork(const WorkItem* item, unsigned threadIndex);
+};
+
+#endif
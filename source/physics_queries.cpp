@@ -0,0 +1,315 @@
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/Graphics/Terrain.h>
+#include <Urho3D/Physics/CollisionShape.h>
+#include <Urho3D/Physics/PhysicsUtils.h>
+#include <Urho3D/Physics/PhysicsWorld.h>
+#include <Urho3D/Physics/RigidBody.h>
+#include <Urho3D/Scene/Node.h>
+
+#include <Bullet/BulletCollision/BroadphaseCollision/btDbvtBroadphase.h>
+#include <Bullet/BulletCollision/CollisionShapes/btSphereShape.h>
+#include <Bullet/BulletDynamics/Dynamics/btDiscreteDynamicsWorld.h>
+
+#include "physics_queries.h"
+#include "telemetry.h"
+
+using namespace Urho3D;
+
+// Sweeps stop this far short of touching, same as PhysicsWorld::SphereCast()
+static const float SWEEP_ALLOWED_PENETRATION = 0.0f;
+
+// Broadphase leaf visitor for ray queries, the per-object half of btCollisionWorld::rayTest()
+struct RayLeafCollider : public btDbvt::ICollide
+{
+	RayLeafCollider(const btTransform& from, const btTransform& to, btCollisionWorld::RayResultCallback& callback) :
+		from_(from),
+		to_(to),
+		callback_(callback)
+	{
+	}
+
+	void Process(const btDbvtNode* leaf)
+	{
+		btBroadphaseProxy* proxy = reinterpret_cast<btBroadphaseProxy*>(leaf->data);
+		if (!callback_.needsCollision(proxy))
+			return;
+		btCollisionObject* object = reinterpret_cast<btCollisionObject*>(proxy->m_clientObject);
+		btCollisionWorld::rayTestSingle(from_, to_, object, object->getCollisionShape(), object->getWorldTransform(),
+			callback_);
+	}
+
+	const btTransform& from_;
+	const btTransform& to_;
+	btCollisionWorld::RayResultCallback& callback_;
+};
+
+// Broadphase leaf visitor for sweep queries, the per-object half of btCollisionWorld::convexSweepTest()
+struct SweepLeafCollider : public btDbvt::ICollide
+{
+	SweepLeafCollider(const btConvexShape* shape, const btTransform& from, const btTransform& to,
+		const btCollisionObject* ignore, btCollisionWorld::ConvexResultCallback& callback) :
+		shape_(shape),
+		from_(from),
+		to_(to),
+		ignore_(ignore),
+		callback_(callback)
+	{
+	}
+
+	void Process(const btDbvtNode* leaf)
+	{
+		btBroadphaseProxy* proxy = reinterpret_cast<btBroadphaseProxy*>(leaf->data);
+		btCollisionObject* object = reinterpret_cast<btCollisionObject*>(proxy->m_clientObject);
+		if (object == ignore_ || !callback_.needsCollision(proxy))
+			return;
+		btCollisionWorld::objectQuerySingle(shape_, from_, to_, object, object->getCollisionShape(),
+			object->getWorldTransform(), callback_, SWEEP_ALLOWED_PENETRATION);
+	}
+
+	const btConvexShape* shape_;
+	const btTransform& from_;
+	const btTransform& to_;
+	const btCollisionObject* ignore_;
+	btCollisionWorld::ConvexResultCallback& callback_;
+};
+
+static btDbvtBroadphase* GetBroadphase(PhysicsWorld* world)
+{
+	// PhysicsWorld always creates a btDbvtBroadphase
+	return static_cast<btDbvtBroadphase*>(world->GetWorld()->getBroadphase());
+}
+
+static void SetNoHit(PhysicsQueryHit& hit)
+{
+	hit.position_ = Vector3::ZERO;
+	hit.normal_ = Vector3::ZERO;
+	hit.distance_ = M_INFINITY;
+	hit.hitFraction_ = 0.0f;
+	hit.body_ = 0;
+}
+
+PhysicsQueryBatch::PhysicsQueryBatch(Context* context) :
+	Object(context),
+	batchSize_(256)
+{
+	workQueue_ = GetSubsystem<WorkQueue>();
+}
+
+PhysicsQueryBatch::~PhysicsQueryBatch()
+{
+}
+
+void PhysicsQueryBatch::SetWorkQueue(WorkQueue* queue)
+{
+	workQueue_ = queue;
+}
+
+void PhysicsQueryBatch::Raycast(PhysicsWorld* world, const PODVector<PhysicsRayQuery>& queries,
+	PODVector<PhysicsQueryHit>& results)
+{
+	results.Resize(queries.Size());
+	if (queries.Empty())
+		return;
+	TELEMETRY_SCOPE("physics.raycast");
+	Run(world, &queries[0], &results[0], queries.Size(), RaycastWork);
+}
+
+void PhysicsQueryBatch::Sweep(PhysicsWorld* world, const PODVector<PhysicsSweepQuery>& queries,
+	PODVector<PhysicsQueryHit>& results)
+{
+	results.Resize(queries.Size());
+	if (queries.Empty())
+		return;
+	TELEMETRY_SCOPE("physics.sweep");
+	Run(world, &queries[0], &results[0], queries.Size(), SweepWork);
+}
+
+void PhysicsQueryBatch::LineOfSight(PhysicsWorld* world, const PODVector<Vector3>& from, const PODVector<Vector3>& to,
+	unsigned collisionMask, PODVector<unsigned char>& visible)
+{
+	const unsigned count = Min(from.Size(), to.Size());
+	rayQueries_.Resize(count);
+	for (unsigned i = 0; i < count; ++i)
+	{
+		PhysicsRayQuery& query = rayQueries_[i];
+		Vector3 delta = to[i] - from[i];
+		query.maxDistance_ = delta.Length();
+		query.ray_ = Ray(from[i], query.maxDistance_ > M_EPSILON ? delta / query.maxDistance_ : Vector3::UP);
+		query.collisionMask_ = collisionMask;
+	}
+	Raycast(world, rayQueries_, rayResults_);
+
+	visible.Resize(count);
+	for (unsigned i = 0; i < count; ++i)
+		visible[i] = rayResults_[i].body_ ? 0 : 1;
+}
+
+void PhysicsQueryBatch::GroundHeights(PhysicsWorld* world, const PODVector<Vector3>& positions, float maxDrop,
+	unsigned collisionMask, PODVector<float>& heights)
+{
+	const unsigned count = positions.Size();
+	rayQueries_.Resize(count);
+	for (unsigned i = 0; i < count; ++i)
+	{
+		PhysicsRayQuery& query = rayQueries_[i];
+		query.ray_ = Ray(positions[i], Vector3::DOWN);
+		query.maxDistance_ = maxDrop;
+		query.collisionMask_ = collisionMask;
+	}
+	Raycast(world, rayQueries_, rayResults_);
+
+	heights.Resize(count);
+	for (unsigned i = 0; i < count; ++i)
+		heights[i] = rayResults_[i].body_ ? rayResults_[i].position_.y_ : positions[i].y_;
+}
+
+void PhysicsQueryBatch::Run(PhysicsWorld* world, const void* queries, PhysicsQueryHit* results, unsigned count,
+	void (*workFunction)(const WorkItem*, unsigned))
+{
+	WorkQueue* queue = workQueue_;
+	const unsigned numBatches = queue ? (count + batchSize_ - 1) / batchSize_ : 1;
+	batches_.Resize(numBatches);
+	for (unsigned i = 0; i < numBatches; ++i)
+	{
+		QueryBatch& batch = batches_[i];
+		batch.world_ = world;
+		batch.queries_ = queries;
+		batch.results_ = results;
+		batch.begin_ = queue ? i * batchSize_ : 0;
+		batch.end_ = queue ? Min(batch.begin_ + batchSize_, count) : count;
+	}
+
+	if (!queue)
+	{
+		WorkItem item;
+		item.aux_ = &batches_[0];
+		workFunction(&item, 0);
+		return;
+	}
+
+	while (items_.Size() < numBatches)
+	{
+		SharedPtr<WorkItem> item(new WorkItem());
+		// Highest priority lets the main thread take part while it waits in Complete()
+		item->priority_ = M_MAX_UNSIGNED;
+		items_.Push(item);
+	}
+	for (unsigned i = 0; i < numBatches; ++i)
+	{
+		items_[i]->workFunction_ = workFunction;
+		items_[i]->aux_ = &batches_[i];
+		queue->AddWorkItem(items_[i]);
+	}
+	queue->Complete(M_MAX_UNSIGNED);
+}
+
+void PhysicsQueryBatch::RaycastWork(const WorkItem* item, unsigned threadIndex)
+{
+	const QueryBatch* batch = reinterpret_cast<const QueryBatch*>(item->aux_);
+	const PhysicsRayQuery* queries = reinterpret_cast<const PhysicsRayQuery*>(batch->queries_);
+	btDbvtBroadphase* broadphase = GetBroadphase(batch->world_);
+
+	for (unsigned i = batch->begin_; i < batch->end_; ++i)
+	{
+		const PhysicsRayQuery& query = queries[i];
+		PhysicsQueryHit& hit = batch->results_[i];
+		SetNoHit(hit);
+		if (query.maxDistance_ <= 0.0f)
+			continue;
+
+		Vector3 end = query.ray_.origin_ + query.maxDistance_ * query.ray_.direction_;
+		btVector3 rayFrom = ToBtVector3(query.ray_.origin_);
+		btVector3 rayTo = ToBtVector3(end);
+		btTransform fromTrans(btQuaternion::getIdentity(), rayFrom);
+		btTransform toTrans(btQuaternion::getIdentity(), rayTo);
+
+		btCollisionWorld::ClosestRayResultCallback callback(rayFrom, rayTo);
+		callback.m_collisionFilterGroup = (short)0xffff;
+		callback.m_collisionFilterMask = (short)query.collisionMask_;
+
+		// The static btDbvt::rayTest() keeps its traversal stack on the calling thread. rayTestInternal() is not used:
+		// depending on the Bullet version it either takes a stack argument or uses one shared by all callers
+		RayLeafCollider collider(fromTrans, toTrans, callback);
+		for (unsigned set = 0; set < 2; ++set)
+			btDbvt::rayTest(broadphase->m_sets[set].m_root, rayFrom, rayTo, collider);
+
+		if (callback.hasHit())
+		{
+			hit.position_ = ToVector3(callback.m_hitPointWorld);
+			hit.normal_ = ToVector3(callback.m_hitNormalWorld);
+			hit.distance_ = (hit.position_ - query.ray_.origin_).Length();
+			hit.hitFraction_ = callback.m_closestHitFraction;
+			hit.body_ = static_cast<RigidBody*>(callback.m_collisionObject->getUserPointer());
+		}
+	}
+}
+
+void PhysicsQueryBatch::SweepWork(const WorkItem* item, unsigned threadIndex)
+{
+	const QueryBatch* batch = reinterpret_cast<const QueryBatch*>(item->aux_);
+	const PhysicsSweepQuery* queries = reinterpret_cast<const PhysicsSweepQuery*>(batch->queries_);
+	btDbvtBroadphase* broadphase = GetBroadphase(batch->world_);
+
+	for (unsigned i = batch->begin_; i < batch->end_; ++i)
+	{
+		const PhysicsSweepQuery& query = queries[i];
+		PhysicsQueryHit& hit = batch->results_[i];
+		SetNoHit(hit);
+
+		btSphereShape sphere(query.radius_);
+		const btConvexShape* shape = &sphere;
+		const btCollisionObject* ignore = 0;
+		if (query.shape_)
+		{
+			btCollisionShape* collisionShape = query.shape_->GetCollisionShape();
+			if (!collisionShape || !collisionShape->isConvex())
+				continue;
+			shape = static_cast<btConvexShape*>(collisionShape);
+			// A shape never sweeps into its own body, like PhysicsWorld::ConvexCast()
+			RigidBody* body = query.shape_->GetComponent<RigidBody>();
+			if (body)
+				ignore = body->GetBody();
+		}
+
+		btQuaternion rotation = ToBtQuaternion(query.rotation_);
+		btTransform fromTrans(rotation, ToBtVector3(query.start_));
+		btTransform toTrans(rotation, ToBtVector3(query.end_));
+		btCollisionWorld::ClosestConvexResultCallback callback(fromTrans.getOrigin(), toTrans.getOrigin());
+		callback.m_collisionFilterGroup = (short)0xffff;
+		callback.m_collisionFilterMask = (short)query.collisionMask_;
+
+		// Only objects overlapping the swept bounds can be hit
+		btVector3 fromMin, fromMax, toMin, toMax;
+		shape->getAabb(fromTrans, fromMin, fromMax);
+		shape->getAabb(toTrans, toMin, toMax);
+		fromMin.setMin(toMin);
+		fromMax.setMax(toMax);
+		btDbvtVolume bounds = btDbvtVolume::FromMM(fromMin, fromMax);
+
+		SweepLeafCollider collider(shape, fromTrans, toTrans, ignore, callback);
+		for (unsigned set = 0; set < 2; ++set)
+		{
+			const btDbvt& tree = broadphase->m_sets[set];
+			tree.collideTV(tree.m_root, bounds, collider);
+		}
+
+		if (callback.hasHit())
+		{
+			hit.position_ = ToVector3(callback.m_hitPointWorld);
+			hit.normal_ = ToVector3(callback.m_hitNormalWorld);
+			hit.hitFraction_ = callback.m_closestHitFraction;
+			hit.distance_ = (query.end_ - query.start_).Length() * hit.hitFraction_;
+			hit.body_ = static_cast<RigidBody*>(callback.m_hitCollisionObject->getUserPointer());
+		}
+	}
+}
+
+void AddTerrainCollision(Terrain* terrain)
+{
+	Node* node = terrain->GetNode();
+	// Static body: mass stays at its default of zero
+	node->GetOrCreateComponent<RigidBody>(LOCAL);
+	CollisionShape* shape = node->GetOrCreateComponent<CollisionShape>(LOCAL);
+	shape->SetTerrain();
+}
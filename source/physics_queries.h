@@ -0,0 +1,116 @@
+#ifndef PHYSICS_QUERIES_H
+#define PHYSICS_QUERIES_H
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Math/Quaternion.h>
+#include <Urho3D/Math/Ray.h>
+
+using namespace Urho3D;
+
+namespace Urho3D
+{
+	class CollisionShape;
+	class PhysicsWorld;
+	class RigidBody;
+	class Terrain;
+	class WorkItem;
+	class WorkQueue;
+}
+
+/// Ray query: closest hit along the ray up to maxDistance_.
+struct PhysicsRayQuery
+{
+	Ray ray_;
+	float maxDistance_;
+	unsigned collisionMask_;
+};
+
+/// Sweep query: closest hit of a sphere of radius_, or of shape_ when set (must be convex), moved from start_ to end_.
+struct PhysicsSweepQuery
+{
+	Vector3 start_;
+	Vector3 end_;
+	/// Orientation of shape_ during the sweep.
+	Quaternion rotation_;
+	float radius_;
+	CollisionShape* shape_;
+	unsigned collisionMask_;
+};
+
+/// Result of one query. body_ is null when nothing was hit.
+struct PhysicsQueryHit
+{
+	Vector3 position_;
+	Vector3 normal_;
+	float distance_;
+	float hitFraction_;
+	RigidBody* body_;
+};
+
+/// Answers arrays of ray and sweep queries against a PhysicsWorld on WorkQueue threads, writing one result per
+/// query into a flat array. Queries walk the Bullet broadphase trees directly instead of going through
+/// btCollisionWorld::rayTest(), whose broadphase traversal uses shared scratch state and is not safe to call from
+/// several threads unless Bullet is built with BT_THREADSAFE. Rays use the static btDbvt::rayTest(), whose stack is
+/// local to the call, on every Bullet version. Results match PhysicsWorld::RaycastSingle(), SphereCast() and
+/// ConvexCast(). The world must not be stepped or modified while a batch runs; calls block until every query is
+/// answered.
+class PhysicsQueryBatch : public Object
+{
+	URHO3D_OBJECT(PhysicsQueryBatch, Object);
+
+public:
+	/// Construct.
+	PhysicsQueryBatch(Context* context);
+	/// Destruct.
+	virtual ~PhysicsQueryBatch();
+
+	/// Answer ray queries. results is resized to match queries.
+	void Raycast(PhysicsWorld* world, const PODVector<PhysicsRayQuery>& queries, PODVector<PhysicsQueryHit>& results);
+	/// Answer sweep queries. results is resized to match queries.
+	void Sweep(PhysicsWorld* world, const PODVector<PhysicsSweepQuery>& queries, PODVector<PhysicsQueryHit>& results);
+	/// Test line of sight between pairs of points. visible[i] is 1 when nothing lies between from[i] and to[i].
+	void LineOfSight(PhysicsWorld* world, const PODVector<Vector3>& from, const PODVector<Vector3>& to,
+		unsigned collisionMask, PODVector<unsigned char>& visible);
+	/// Find the ground below each position by casting down up to maxDrop. heights[i] is the ground height, or the
+	/// position's own height when there is no ground below.
+	void GroundHeights(PhysicsWorld* world, const PODVector<Vector3>& positions, float maxDrop, unsigned collisionMask,
+		PODVector<float>& heights);
+
+	/// Set the work queue to run on. Defaults to the WorkQueue subsystem.
+	void SetWorkQueue(WorkQueue* queue);
+	/// Set queries per work item.
+	void SetBatchSize(unsigned size) { batchSize_ = Max(size, 1U); }
+	unsigned GetBatchSize() const { return batchSize_; }
+
+private:
+	/// Range of queries answered by one work item.
+	struct QueryBatch
+	{
+		PhysicsWorld* world_;
+		const void* queries_;
+		PhysicsQueryHit* results_;
+		unsigned begin_;
+		unsigned end_;
+	};
+
+	WeakPtr<WorkQueue> workQueue_;
+	unsigned batchSize_;
+	// Reused between calls so answering does not allocate
+	PODVector<QueryBatch> batches_;
+	Vector<SharedPtr<WorkItem> > items_;
+	PODVector<PhysicsRayQuery> rayQueries_;
+	PODVector<PhysicsQueryHit> rayResults_;
+
+	// Split [0, count) into work items running workFunction and wait for them
+	void Run(PhysicsWorld* world, const void* queries, PhysicsQueryHit* results, unsigned count,
+		void (*workFunction)(const WorkItem*, unsigned));
+
+	// Worker thread entry points
+	static void RaycastWork(const WorkItem* item, unsigned threadIndex);
+	static void SweepWork(const WorkItem* item, unsigned threadIndex);
+};
+
+/// Give a Terrain heightfield collision: a static RigidBody and a CollisionShape built from its height data.
+void AddTerrainCollision(Terrain* terrain);
+
+#endif
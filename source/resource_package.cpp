@@ -0,0 +1,238 @@
+#include <Urho3D/Container/Sort.h>
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/IO/Compression.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Resource/XMLFile.h>
+
+#include "resource_package.h"
+
+using namespace Urho3D;
+
+// Uncompressed size of each LZ4 block; the block header stores sizes as 16-bit values
+static const unsigned PACKAGE_BLOCK_SIZE = 32768;
+
+ResourcePackager::ResourcePackager(Context* context) :
+	Object(context),
+	sourceSize_(0),
+	packageSize_(0)
+{
+}
+
+void ResourcePackager::Clear()
+{
+	resources_.Clear();
+	visited_.Clear();
+	sourceSize_ = 0;
+	packageSize_ = 0;
+}
+
+bool ResourcePackager::AddResource(const String& name)
+{
+	ResourceCache* cache = GetSubsystem<ResourceCache>();
+	String sanitated = cache->SanitateResourceName(name);
+	if (visited_.Contains(sanitated))
+		return true;
+	visited_.Insert(sanitated);
+
+	SharedPtr<File> file = cache->GetFile(sanitated, false);
+	if (!file)
+		return false;
+	resources_.Push(sanitated);
+	sourceSize_ += file->GetSize();
+
+	String extension = GetExtension(sanitated);
+	if (extension == ".xml")
+	{
+		SharedPtr<XMLFile> xml(new XMLFile(context_));
+		if (xml->Load(*file))
+			AddXMLDependencies(xml->GetRoot());
+	}
+	else if (extension == ".glsl" || extension == ".hlsl")
+		AddShaderIncludes(sanitated);
+	else if (extension == ".png" || extension == ".jpg" || extension == ".tga" || extension == ".bmp" ||
+		extension == ".dds" || extension == ".ktx" || extension == ".pvr")
+	{
+		// Texture parameters (filtering, addressing, mips) live next to the image
+		String parameters = ReplaceExtension(sanitated, ".xml");
+		if (cache->Exists(parameters))
+			AddResource(parameters);
+	}
+	return true;
+}
+
+void ResourcePackager::AddXMLDependencies(const XMLElement& element)
+{
+	ResourceCache* cache = GetSubsystem<ResourceCache>();
+	Vector<String> names = element.GetAttributeNames();
+	for (unsigned i = 0; i < names.Size(); ++i)
+	{
+		String value = element.GetAttribute(names[i]);
+		if (names[i] == "vs" || names[i] == "ps")
+		{
+			AddShader(value);
+			continue;
+		}
+
+		// Resource names are the parts with an extension that exist; type names and other values are skipped
+		Vector<String> parts = value.Split(';');
+		for (unsigned j = 0; j < parts.Size(); ++j)
+		{
+			String part = parts[j].Trimmed();
+			if (!GetExtension(part).Empty() && cache->Exists(part))
+				AddResource(part);
+		}
+	}
+
+	for (XMLElement child = element.GetChild(); child; child = child.GetNext())
+		AddXMLDependencies(child);
+}
+
+void ResourcePackager::AddShader(const String& name)
+{
+	if (name.Empty())
+		return;
+	ResourceCache* cache = GetSubsystem<ResourceCache>();
+	const char* languages[] = { "Shaders/GLSL/", ".glsl", "Shaders/HLSL/", ".hlsl" };
+	for (unsigned i = 0; i < sizeof(languages) / sizeof(languages[0]); i += 2)
+	{
+		String shaderName = String(languages[i]) + name + languages[i + 1];
+		if (cache->Exists(shaderName))
+			AddResource(shaderName);
+	}
+}
+
+void ResourcePackager::AddShaderIncludes(const String& name)
+{
+	SharedPtr<File> file = GetSubsystem<ResourceCache>()->GetFile(name, false);
+	if (!file)
+		return;
+
+	// Includes are relative to the including shader, as in Shader::ProcessSource()
+	String path = GetPath(name);
+	while (!file->IsEof())
+	{
+		String line = file->ReadLine().Trimmed();
+		if (!line.StartsWith("#include"))
+			continue;
+		String include = line.Substring(9).Replaced("\"", "").Trimmed();
+		AddResource(path + include);
+	}
+}
+
+bool ResourcePackager::Write(const String& fileName)
+{
+	ResourceCache* cache = GetSubsystem<ResourceCache>();
+	FileSystem* fileSystem = GetSubsystem<FileSystem>();
+	Sort(resources_.Begin(), resources_.End());
+
+	// Written next to the target and renamed over it once complete, so a failed build never leaves a partial package
+	String tempName = fileName + ".tmp";
+	SharedPtr<File> dest(new File(context_, tempName, FILE_WRITE));
+	if (!dest->IsOpen())
+	{
+		URHO3D_LOGERROR("Could not open " + tempName + " for writing");
+		return false;
+	}
+
+	// Header and index; offsets and checksums are filled in once the data has been written
+	const unsigned count = resources_.Size();
+	PODVector<unsigned> offsets(count);
+	PODVector<unsigned> sizes(count);
+	PODVector<unsigned> checksums(count);
+	unsigned checksum = 0;
+	dest->WriteFileID("ULZ4");
+	dest->WriteUInt(count);
+	dest->WriteUInt(checksum);
+	for (unsigned i = 0; i < count; ++i)
+	{
+		dest->WriteString(resources_[i]);
+		dest->WriteUInt(0);
+		dest->WriteUInt(0);
+		dest->WriteUInt(0);
+	}
+
+	PODVector<unsigned char> buffer;
+	PODVector<unsigned char> compressed(EstimateCompressBound(PACKAGE_BLOCK_SIZE));
+	bool success = true;
+	for (unsigned i = 0; i < count && success; ++i)
+	{
+		SharedPtr<File> source = cache->GetFile(resources_[i], false);
+		if (!source)
+		{
+			URHO3D_LOGERROR("Could not read " + resources_[i]);
+			success = false;
+			break;
+		}
+		unsigned size = source->GetSize();
+		buffer.Resize(size);
+		if (size && source->Read(&buffer[0], size) != size)
+		{
+			URHO3D_LOGERROR("Could not read " + resources_[i]);
+			success = false;
+			break;
+		}
+
+		offsets[i] = dest->GetPosition();
+		sizes[i] = size;
+		checksums[i] = 0;
+		for (unsigned j = 0; j < size; ++j)
+		{
+			checksums[i] = SDBMHash(checksums[i], buffer[j]);
+			checksum = SDBMHash(checksum, buffer[j]);
+		}
+
+		// Independent blocks, as File decompresses package entries one block at a time
+		for (unsigned pos = 0; pos < size; pos += PACKAGE_BLOCK_SIZE)
+		{
+			unsigned unpacked = Min(size - pos, PACKAGE_BLOCK_SIZE);
+			unsigned packed = CompressData(&compressed[0], &buffer[pos], unpacked);
+			if (!packed)
+			{
+				URHO3D_LOGERROR("Could not compress " + resources_[i]);
+				success = false;
+				break;
+			}
+			dest->WriteUShort((unsigned short)unpacked);
+			dest->WriteUShort((unsigned short)packed);
+			dest->Write(&compressed[0], packed);
+		}
+	}
+
+	if (success)
+	{
+		// Package size at the very end, which PackageFile uses to find a package appended to another file
+		dest->WriteUInt(dest->GetSize() + sizeof(unsigned));
+		packageSize_ = dest->GetSize();
+
+		dest->Seek(4);
+		dest->WriteUInt(count);
+		dest->WriteUInt(checksum);
+		for (unsigned i = 0; i < count; ++i)
+		{
+			dest->WriteString(resources_[i]);
+			dest->WriteUInt(offsets[i]);
+			dest->WriteUInt(sizes[i]);
+			dest->WriteUInt(checksums[i]);
+		}
+	}
+	dest->Close();
+
+	if (!success)
+	{
+		fileSystem->Delete(tempName);
+		return false;
+	}
+	if (fileSystem->FileExists(fileName))
+		fileSystem->Delete(fileName);
+	if (!fileSystem->Rename(tempName, fileName))
+	{
+		URHO3D_LOGERROR("Could not move package into place at " + fileName);
+		return false;
+	}
+	URHO3D_LOGINFOF("Wrote %s: %u resources, %u bytes from %u bytes of loose files", fileName.CString(), count,
+		packageSize_, sourceSize_);
+	return true;
+}
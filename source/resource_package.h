@@ -0,0 +1,59 @@
+#ifndef RESOURCE_PACKAGE_H
+#define RESOURCE_PACKAGE_H
+
+#include <Urho3D/Container/HashSet.h>
+#include <Urho3D/Core/Object.h>
+
+using namespace Urho3D;
+
+namespace Urho3D
+{
+	class XMLElement;
+}
+
+/// Collects the resources a scene depends on and writes them into one LZ4-compressed package in Urho3D's "ULZ4"
+/// PackageFile format, with the index sorted by name. Mounted with ResourceCache::AddPackageFile(), the package is
+/// searched ahead of the loose resource directories as long as ResourceCache::SetSearchPackagesFirst() is on (the
+/// default); the directories remain as a fallback for anything it does not hold. The priority passed to
+/// AddPackageFile() only orders packages among themselves, with 0 first.
+///
+/// Dependencies are found by walking XML resources: every attribute value (or ';'-separated part of one, as in
+/// ResourceRef and ResourceRefList values) that names an existing resource is followed, as are the vs and ps
+/// shaders of technique passes and the #includes of those shaders. Images also bring their parameter XML file.
+class ResourcePackager : public Object
+{
+	URHO3D_OBJECT(ResourcePackager, Object);
+
+public:
+	/// Construct.
+	ResourcePackager(Context* context);
+
+	/// Add a resource and everything it depends on. Returns false if the resource does not exist.
+	bool AddResource(const String& name);
+	/// Write the package. Returns false on failure, leaving any existing file in place.
+	bool Write(const String& fileName);
+	/// Remove all collected resources.
+	void Clear();
+
+	/// Return collected resource names, sorted once the package has been written.
+	const Vector<String>& GetResources() const { return resources_; }
+	/// Return total size of the collected resources as loose files, in bytes.
+	unsigned GetSourceSize() const { return sourceSize_; }
+	/// Return size of the last package written, in bytes.
+	unsigned GetPackageSize() const { return packageSize_; }
+
+private:
+	Vector<String> resources_;
+	HashSet<String> visited_;
+	unsigned sourceSize_;
+	unsigned packageSize_;
+
+	// Add dependencies named in an XML element and its children
+	void AddXMLDependencies(const XMLElement& element);
+	// Add a shader by name without extension, for every shader language present
+	void AddShader(const String& name);
+	// Add files a shader source #includes
+	void AddShaderIncludes(const String& name);
+};
+
+#endif
@@ -0,0 +1,219 @@
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/Timer.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/IO/MemoryBuffer.h>
+#include <Urho3D/LibraryInfo.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "scene_cache.h"
+
+using namespace Urho3D;
+
+// Bump when the header layout changes
+static const unsigned SCENE_CACHE_VERSION = 1;
+
+/// Read-only view of a whole file. Uses mmap where available and falls back to reading into memory.
+class MappedFile
+{
+public:
+	MappedFile() :
+		data_(0),
+		size_(0)
+	{
+	}
+
+	~MappedFile()
+	{
+#ifndef _WIN32
+		if (data_)
+			munmap(data_, size_);
+#endif
+	}
+
+	bool Open(Context* context, const String& fileName)
+	{
+#ifndef _WIN32
+		int fd = open(GetNativePath(fileName).CString(), O_RDONLY);
+		if (fd < 0)
+			return false;
+		struct stat info;
+		if (fstat(fd, &info) == 0 && info.st_size > 0)
+		{
+			void* data = mmap(0, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (data != MAP_FAILED)
+			{
+				data_ = data;
+				size_ = (unsigned)info.st_size;
+			}
+		}
+		close(fd);
+		return data_ != 0;
+#else
+		File file(context, fileName);
+		if (!file.IsOpen() || !file.GetSize())
+			return false;
+		buffer_.Resize(file.GetSize());
+		size_ = file.Read(&buffer_[0], buffer_.Size());
+		return size_ == buffer_.Size();
+#endif
+	}
+
+	const void* GetData() const
+	{
+#ifndef _WIN32
+		return data_;
+#else
+		return buffer_.Empty() ? 0 : &buffer_[0];
+#endif
+	}
+
+	unsigned GetSize() const { return size_; }
+
+private:
+	void* data_;
+	unsigned size_;
+#ifdef _WIN32
+	PODVector<unsigned char> buffer_;
+#endif
+};
+
+SceneCache::SceneCache(Context* context) :
+	Object(context)
+{
+	SetDirectory(GetSubsystem<FileSystem>()->GetAppPreferencesDir("urho3d-test", "SceneCache"));
+}
+
+void SceneCache::SetDirectory(const String& directory)
+{
+	directory_ = AddTrailingSlash(directory);
+	GetSubsystem<FileSystem>()->CreateDir(directory_);
+}
+
+String SceneCache::GetSnapshotName(const String& sourceName) const
+{
+	String flatName = sourceName;
+	flatName.Replace('/', '_');
+	flatName.Replace('\\', '_');
+	return directory_ + flatName + ".bin";
+}
+
+bool SceneCache::GetSourceKey(const String& sourceName, SceneSourceKey& key)
+{
+	ResourceCache* cache = GetSubsystem<ResourceCache>();
+	SharedPtr<File> file = cache->GetFile(sourceName, false);
+	if (!file)
+		return false;
+
+	key.size_ = file->GetSize();
+	key.revision_ = GetRevision();
+	// Loose files are keyed on their modification time, which costs a stat; packaged files on their checksum
+	String fullName = cache->GetResourceFileName(sourceName);
+	if (!fullName.Empty())
+		key.stamp_ = GetSubsystem<FileSystem>()->GetLastModifiedTime(fullName);
+	else
+		key.stamp_ = file->GetChecksum();
+	return true;
+}
+
+bool SceneCache::ReadHeader(Deserializer& source, const SceneSourceKey& key)
+{
+	if (source.ReadFileID() != "FPSC" || source.ReadUInt() != SCENE_CACHE_VERSION)
+		return false;
+
+	SceneSourceKey snapshotKey;
+	snapshotKey.stamp_ = source.ReadUInt();
+	snapshotKey.size_ = source.ReadUInt();
+	snapshotKey.revision_ = source.ReadString();
+	return snapshotKey == key;
+}
+
+bool SceneCache::LoadSnapshot(Scene* scene, const String& sourceName)
+{
+	SceneSourceKey key;
+	if (!scene || !GetSourceKey(sourceName, key))
+		return false;
+
+	MappedFile mapped;
+	if (!mapped.Open(context_, GetSnapshotName(sourceName)))
+		return false;
+
+	MemoryBuffer buffer(mapped.GetData(), mapped.GetSize());
+	if (!ReadHeader(buffer, key))
+	{
+		URHO3D_LOGINFO("Scene snapshot of " + sourceName + " is stale, loading XML");
+		return false;
+	}
+	return scene->Load(buffer);
+}
+
+SharedPtr<File> SceneCache::OpenSnapshot(const String& sourceName)
+{
+	SceneSourceKey key;
+	if (!GetSourceKey(sourceName, key))
+		return SharedPtr<File>();
+
+	String snapshotName = GetSnapshotName(sourceName);
+	if (!GetSubsystem<FileSystem>()->FileExists(snapshotName))
+		return SharedPtr<File>();
+
+	SharedPtr<File> file(new File(context_, snapshotName));
+	if (!file->IsOpen() || !ReadHeader(*file, key))
+	{
+		URHO3D_LOGINFO("Scene snapshot of " + sourceName + " is stale, loading XML");
+		return SharedPtr<File>();
+	}
+	return file;
+}
+
+bool SceneCache::SaveSnapshot(Scene* scene, const String& sourceName)
+{
+	SceneSourceKey key;
+	if (!scene || !GetSourceKey(sourceName, key))
+		return false;
+
+	// Write to a temporary name and rename, so a crash never leaves a truncated snapshot with a valid header
+	String snapshotName = GetSnapshotName(sourceName);
+	String tempName = snapshotName + ".tmp";
+	HiresTimer timer;
+	{
+		File file(context_);
+		if (!file.Open(tempName, FILE_WRITE))
+			return false;
+		file.WriteFileID("FPSC");
+		file.WriteUInt(SCENE_CACHE_VERSION);
+		file.WriteUInt(key.stamp_);
+		file.WriteUInt(key.size_);
+		file.WriteString(key.revision_);
+		if (!scene->Save(file))
+		{
+			file.Close();
+			GetSubsystem<FileSystem>()->Delete(tempName);
+			return false;
+		}
+	}
+
+	FileSystem* fileSystem = GetSubsystem<FileSystem>();
+	fileSystem->Delete(snapshotName);
+	if (!fileSystem->Rename(tempName, snapshotName))
+		return false;
+	URHO3D_LOGINFOF("Wrote scene snapshot %s in %.2f ms", snapshotName.CString(), timer.GetUSec(false) / 1000.0f);
+	return true;
+}
+
+void SceneCache::RemoveSnapshot(const String& sourceName)
+{
+	String snapshotName = GetSnapshotName(sourceName);
+	FileSystem* fileSystem = GetSubsystem<FileSystem>();
+	if (fileSystem->FileExists(snapshotName))
+		fileSystem->Delete(snapshotName);
+}
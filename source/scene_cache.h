@@ -0,0 +1,73 @@
+#ifndef SCENE_CACHE_H
+#define SCENE_CACHE_H
+
+#include <Urho3D/Core/Object.h>
+
+using namespace Urho3D;
+
+namespace Urho3D
+{
+	class Deserializer;
+	class File;
+	class Scene;
+}
+
+/// Identity of a scene source file. A snapshot is only valid for the key it was built from.
+struct SceneSourceKey
+{
+	SceneSourceKey() :
+		stamp_(0),
+		size_(0)
+	{
+	}
+
+	bool operator ==(const SceneSourceKey& rhs) const
+	{
+		return stamp_ == rhs.stamp_ && size_ == rhs.size_ && revision_ == rhs.revision_;
+	}
+
+	/// Modification time of the source, or its checksum when it does not live in a resource directory.
+	unsigned stamp_;
+	/// Source size in bytes.
+	unsigned size_;
+	/// Engine revision the snapshot was written with.
+	String revision_;
+};
+
+/// Binary snapshots of XML scenes. The first load of a scene writes it out with Scene::Save() next to a header
+/// holding the source key; later loads read the binary form instead of parsing the XML. A snapshot whose key no
+/// longer matches the source (edited file or different engine revision) is ignored and rebuilt.
+class SceneCache : public Object
+{
+	URHO3D_OBJECT(SceneCache, Object);
+
+public:
+	/// Construct. Snapshots go to the application preferences directory by default.
+	SceneCache(Context* context);
+
+	/// Set directory for snapshot files.
+	void SetDirectory(const String& directory);
+	/// Load a valid snapshot of the source scene resource through a memory mapping. Returns false if there is none.
+	bool LoadSnapshot(Scene* scene, const String& sourceName);
+	/// Open a valid snapshot positioned at the start of the binary scene, for Scene::LoadAsync(). Returns null if
+	/// there is none.
+	SharedPtr<File> OpenSnapshot(const String& sourceName);
+	/// Write a snapshot of a scene that was just loaded from the source scene resource.
+	bool SaveSnapshot(Scene* scene, const String& sourceName);
+	/// Delete the snapshot of a source scene resource.
+	void RemoveSnapshot(const String& sourceName);
+
+	const String& GetDirectory() const { return directory_; }
+	/// Return the snapshot file name for a source scene resource.
+	String GetSnapshotName(const String& sourceName) const;
+
+private:
+	String directory_;
+
+	// Compute the current key of a source scene resource. Returns false if it does not exist
+	bool GetSourceKey(const String& sourceName, SceneSourceKey& key);
+	// Read and check a snapshot header. Returns true if it matches key
+	bool ReadHeader(Deserializer& source, const SceneSourceKey& key);
+};
+
+#endif
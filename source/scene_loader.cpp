@@ -0,0 +1,176 @@
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Resource/ResourceEvents.h>
+#include <Urho3D/Scene/Scene.h>
+#include <Urho3D/Scene/SceneEvents.h>
+
+#include "scene_cache.h"
+#include "scene_loader.h"
+#include "telemetry.h"
+
+using namespace Urho3D;
+
+SceneLoader::SceneLoader(Context* context) :
+	Object(context),
+	timeBudget_(5),
+	savedFinishMs_(-1)
+{
+}
+
+SceneLoader::~SceneLoader()
+{
+	RestoreResourceBudget();
+}
+
+void SceneLoader::SetTimeBudget(int milliseconds)
+{
+	timeBudget_ = Max(milliseconds, 1);
+}
+
+bool SceneLoader::IsLoading() const
+{
+	return scene_ && scene_->IsAsyncLoading();
+}
+
+float SceneLoader::GetProgress() const
+{
+	if (!scene_)
+		return 0.0f;
+	return scene_->IsAsyncLoading() ? scene_->GetAsyncProgress() : 1.0f;
+}
+
+bool SceneLoader::Load(Scene* scene, const String& fileName, bool async)
+{
+	if (!scene)
+		return false;
+	if (IsLoading())
+		scene_->StopAsyncLoading();
+
+	UnsubscribeFromAllEvents();
+	RestoreResourceBudget();
+	scene_ = scene;
+	fileName_ = fileName;
+	stats_ = SceneLoadStats();
+	stats_.async_ = async;
+	wallTimer_.Reset();
+
+	// A binary snapshot, when the SceneCache subsystem has a valid one, replaces the XML parse
+	ResourceCache* cache = GetSubsystem<ResourceCache>();
+	SceneCache* sceneCache = GetSubsystem<SceneCache>();
+	if (!async)
+	{
+		bool success = sceneCache && sceneCache->LoadSnapshot(scene, fileName);
+		stats_.snapshot_ = success;
+		if (!success)
+		{
+			SharedPtr<File> file = cache->GetFile(fileName);
+			success = file && scene->LoadXML(*file);
+		}
+		stats_.wallTime_ = stats_.mainThreadTime_ = stats_.longestFrame_ = wallTimer_.GetUSec(false);
+		// Straight after the parse, before the scene has been updated, so the snapshot holds exactly the XML's state
+		if (success && !stats_.snapshot_ && sceneCache)
+			sceneCache->SaveSnapshot(scene, fileName);
+		return success;
+	}
+
+	SharedPtr<File> file;
+	if (sceneCache)
+		file = sceneCache->OpenSnapshot(fileName);
+	stats_.snapshot_ = file.NotNull();
+	if (!file)
+		file = cache->GetFile(fileName);
+	if (!file)
+		return false;
+
+	// The budget is a ResourceCache-wide setting; the previous value is put back when the load ends
+	savedFinishMs_ = cache->GetFinishBackgroundResourcesMs();
+	cache->SetFinishBackgroundResourcesMs(timeBudget_);
+	scene->SetAsyncLoadingMs(timeBudget_);
+
+	SubscribeToEvent(E_POSTUPDATE, URHO3D_HANDLER(SceneLoader, HandlePostUpdate));
+	SubscribeToEvent(E_ENDFRAME, URHO3D_HANDLER(SceneLoader, HandleEndFrame));
+	SubscribeToEvent(E_RESOURCEBACKGROUNDLOADED, URHO3D_HANDLER(SceneLoader, HandleResourceBackgroundLoaded));
+	SubscribeToEvent(scene, E_ASYNCLOADFINISHED, URHO3D_HANDLER(SceneLoader, HandleAsyncLoadFinished));
+
+	// The XML is parsed (or the snapshot header read) and the resource requests are queued here, on the calling thread
+	bool success = stats_.snapshot_ ? scene->LoadAsync(file) : scene->LoadAsyncXML(file);
+	AddMainThreadTime(wallTimer_.GetUSec(false));
+	frameTimer_.Reset();
+	if (!success)
+	{
+		UnsubscribeFromAllEvents();
+		RestoreResourceBudget();
+	}
+	return success;
+}
+
+void SceneLoader::RestoreResourceBudget()
+{
+	if (savedFinishMs_ < 0)
+		return;
+	ResourceCache* cache = GetSubsystem<ResourceCache>();
+	if (cache)
+		cache->SetFinishBackgroundResourcesMs(savedFinishMs_);
+	savedFinishMs_ = -1;
+}
+
+void SceneLoader::AddMainThreadTime(long long usec)
+{
+	stats_.mainThreadTime_ += usec;
+	if (usec > stats_.longestFrame_)
+		stats_.longestFrame_ = usec;
+}
+
+void SceneLoader::HandlePostUpdate(StringHash eventType, VariantMap& eventData)
+{
+	++stats_.frames_;
+	AddMainThreadTime(frameTimer_.GetUSec(false));
+}
+
+void SceneLoader::HandleEndFrame(StringHash eventType, VariantMap& eventData)
+{
+	frameTimer_.Reset();
+}
+
+void SceneLoader::HandleResourceBackgroundLoaded(StringHash eventType, VariantMap& eventData)
+{
+	using namespace ResourceBackgroundLoaded;
+
+	++stats_.resources_;
+	float readyMs = wallTimer_.GetUSec(false) / 1000.0f;
+	Telemetry* telemetry = GetSubsystem<Telemetry>();
+	if (telemetry)
+		telemetry->Record("scene.resource.ready", readyMs);
+	URHO3D_LOGDEBUGF("Background loaded %s%s, ready after %.2f ms", eventData[P_RESOURCENAME].GetString().CString(),
+		eventData[P_SUCCESS].GetBool() ? "" : " (failed)", readyMs);
+}
+
+void SceneLoader::HandleAsyncLoadFinished(StringHash eventType, VariantMap& eventData)
+{
+	// Sent from the scene update, so the current frame's slice has not been counted by HandlePostUpdate yet
+	++stats_.frames_;
+	AddMainThreadTime(frameTimer_.GetUSec(false));
+	stats_.wallTime_ = wallTimer_.GetUSec(false);
+	UnsubscribeFromAllEvents();
+	RestoreResourceBudget();
+
+	if (!stats_.snapshot_)
+		SaveSnapshotFromSource();
+}
+
+void SceneLoader::SaveSnapshotFromSource()
+{
+	SceneCache* sceneCache = GetSubsystem<SceneCache>();
+	if (!sceneCache)
+		return;
+	// The loaded scene has been updating while it loaded, so physics and elapsed time have moved on from the XML.
+	// The snapshot is built from a fresh parse instead; the resources are all cached by now, so this is the parse
+	// and instantiation only
+	SharedPtr<File> file = GetSubsystem<ResourceCache>()->GetFile(fileName_);
+	SharedPtr<Scene> source(new Scene(context_));
+	if (file && source->LoadXML(*file))
+		sceneCache->SaveSnapshot(source, fileName_);
+}
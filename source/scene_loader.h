@@ -0,0 +1,103 @@
+#ifndef SCENE_LOADER_H
+#define SCENE_LOADER_H
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Core/Timer.h>
+
+using namespace Urho3D;
+
+namespace Urho3D
+{
+	class Scene;
+}
+
+/// Timing of the last scene load. Times are in microseconds.
+struct SceneLoadStats
+{
+	SceneLoadStats() :
+		async_(false),
+		snapshot_(false),
+		wallTime_(0),
+		mainThreadTime_(0),
+		longestFrame_(0),
+		frames_(0),
+		resources_(0)
+	{
+	}
+
+	/// Whether the load went through the async path.
+	bool async_;
+	/// Whether the scene came from a SceneCache snapshot instead of XML.
+	bool snapshot_;
+	/// Time from the load request until the scene was complete.
+	long long wallTime_;
+	/// Main-thread time spent on loading work: the initial request plus, for each frame while loading, the part
+	/// of the frame up to the end of the update phase (background resource finishing and node instantiation).
+	long long mainThreadTime_;
+	/// Longest single main-thread slice, i.e. the worst hitch caused by loading.
+	long long longestFrame_;
+	/// Frames run while loading.
+	unsigned frames_;
+	/// Resources finished by the background loader.
+	unsigned resources_;
+};
+
+/// Loads a scene either synchronously or through Scene::LoadAsyncXML, which pulls resources in with the
+/// ResourceCache background loader and instantiates nodes over several frames under a per-frame time budget.
+/// Records how much of the load ran on the main thread. Uses a binary snapshot from the SceneCache subsystem when
+/// one is registered and holds a valid snapshot, and writes one after an XML load. Snapshots always hold the XML's
+/// state before any scene update; after an async load that takes a second, synchronous parse.
+class SceneLoader : public Object
+{
+	URHO3D_OBJECT(SceneLoader, Object);
+
+public:
+	/// Construct.
+	SceneLoader(Context* context);
+	/// Destruct. Restores the ResourceCache budget if a load is still in progress.
+	virtual ~SceneLoader();
+
+	/// Start loading fileName into scene. When async is false the load has finished on return. Returns false if
+	/// the file could not be opened or parsed.
+	bool Load(Scene* scene, const String& fileName, bool async);
+	/// Set per-frame time budget in milliseconds for instantiating nodes and finishing background-loaded resources.
+	void SetTimeBudget(int milliseconds);
+
+	/// Return whether an async load is in progress.
+	bool IsLoading() const;
+	/// Return progress of the current load from 0 to 1.
+	float GetProgress() const;
+	const SceneLoadStats& GetStats() const { return stats_; }
+	int GetTimeBudget() const { return timeBudget_; }
+
+private:
+	WeakPtr<Scene> scene_;
+	// Scene resource being loaded
+	String fileName_;
+	int timeBudget_;
+	// ResourceCache finish budget from before the current async load, or -1 when not overridden
+	int savedFinishMs_;
+	SceneLoadStats stats_;
+	// Started when the load was requested
+	HiresTimer wallTimer_;
+	// Reset at the end of every frame; read at the end of the next frame's update phase
+	HiresTimer frameTimer_;
+
+	// Put back the ResourceCache finish budget saved when the async load started
+	void RestoreResourceBudget();
+	// Write a snapshot from a fresh, never updated parse of the XML
+	void SaveSnapshotFromSource();
+	// Add a slice of main-thread loading work
+	void AddMainThreadTime(long long usec);
+
+	// Handle end of the update phase while loading
+	void HandlePostUpdate(StringHash eventType, VariantMap& eventData);
+	// Handle frame end while loading
+	void HandleEndFrame(StringHash eventType, VariantMap& eventData);
+	// Handle a resource finished by the background loader
+	void HandleResourceBackgroundLoaded(StringHash eventType, VariantMap& eventData);
+	// Handle async load completion
+	void HandleAsyncLoadFinished(StringHash eventType, VariantMap& eventData);
+};
+
+#endif
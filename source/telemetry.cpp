@@ -0,0 +1,226 @@
+#include <cstdio>
+
+#include <Urho3D/Container/HashSet.h>
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Core/Thread.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/Log.h>
+#include <Urho3D/Math/MathDefs.h>
+
+#include "telemetry.h"
+
+using namespace Urho3D;
+
+// Binary file layout: "FPTL" id and a version, followed by records. A name record (hash, null-terminated name)
+// is written the first time a name is seen; sample records (frame, name hash, value) refer to it by hash.
+static const unsigned TELEMETRY_BINARY_VERSION = 1;
+static const unsigned char TELEMETRY_RECORD_NAME = 0;
+static const unsigned char TELEMETRY_RECORD_SAMPLE = 1;
+// How long the drain thread sleeps when the ring is empty
+static const unsigned TELEMETRY_DRAIN_INTERVAL_MS = 5;
+
+TelemetryRing::TelemetryRing(unsigned capacity) :
+	enqueuePos_(0),
+	dequeuePos_(0)
+{
+	capacity = NextPowerOfTwo(Max(capacity, 2U));
+	mask_ = capacity - 1;
+	cells_ = new Cell[capacity];
+	for (unsigned i = 0; i < capacity; ++i)
+		cells_[i].sequence_.store(i, std::memory_order_relaxed);
+}
+
+TelemetryRing::~TelemetryRing()
+{
+	delete[] cells_;
+}
+
+bool TelemetryRing::Push(const TelemetrySample& sample)
+{
+	// Each cell's sequence tells whose turn it is: equal to the position when free for a producer, position + 1
+	// once written and ready for the consumer
+	unsigned pos = enqueuePos_.load(std::memory_order_relaxed);
+	Cell* cell;
+	for (;;)
+	{
+		cell = &cells_[pos & mask_];
+		unsigned sequence = cell->sequence_.load(std::memory_order_acquire);
+		int diff = (int)(sequence - pos);
+		if (diff == 0)
+		{
+			if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (diff < 0)
+			return false;
+		else
+			pos = enqueuePos_.load(std::memory_order_relaxed);
+	}
+
+	cell->sample_ = sample;
+	cell->sequence_.store(pos + 1, std::memory_order_release);
+	return true;
+}
+
+bool TelemetryRing::Pop(TelemetrySample& sample)
+{
+	Cell* cell = &cells_[dequeuePos_ & mask_];
+	unsigned sequence = cell->sequence_.load(std::memory_order_acquire);
+	if ((int)(sequence - (dequeuePos_ + 1)) < 0)
+		return false;
+
+	sample = cell->sample_;
+	cell->sequence_.store(dequeuePos_ + mask_ + 1, std::memory_order_release);
+	++dequeuePos_;
+	return true;
+}
+
+/// Background thread that drains the telemetry ring into a file.
+class TelemetryWriter : public Thread
+{
+public:
+	TelemetryWriter(Telemetry* telemetry, File* file, bool csv) :
+		telemetry_(telemetry),
+		file_(file),
+		csv_(csv)
+	{
+		if (csv_)
+			file_->WriteLine("frame,name,ms");
+		else
+		{
+			file_->WriteFileID("FPTL");
+			file_->WriteUInt(TELEMETRY_BINARY_VERSION);
+		}
+	}
+
+	virtual void ThreadFunction()
+	{
+		while (shouldRun_)
+		{
+			if (!Drain())
+				Time::Sleep(TELEMETRY_DRAIN_INTERVAL_MS);
+		}
+	}
+
+	/// Write out all samples currently in the ring. Returns false if it was empty.
+	bool Drain()
+	{
+		TelemetrySample sample;
+		bool any = false;
+		while (telemetry_->Pop(sample))
+		{
+			Write(sample);
+			any = true;
+		}
+		return any;
+	}
+
+	File* GetFile() const { return file_; }
+
+private:
+	Telemetry* telemetry_;
+	SharedPtr<File> file_;
+	bool csv_;
+	// Names that already have a name record in the binary file
+	HashSet<StringHash> writtenNames_;
+
+	void Write(const TelemetrySample& sample)
+	{
+		if (csv_)
+		{
+			char line[256];
+			int length = snprintf(line, sizeof(line), "%u,%s,%.4f\n", sample.frame_, sample.name_, sample.value_);
+			if (length > 0)
+				file_->Write(line, (unsigned)Min(length, (int)sizeof(line) - 1));
+			return;
+		}
+
+		StringHash nameHash(sample.name_);
+		if (!writtenNames_.Contains(nameHash))
+		{
+			writtenNames_.Insert(nameHash);
+			file_->WriteUByte(TELEMETRY_RECORD_NAME);
+			file_->WriteStringHash(nameHash);
+			file_->WriteString(sample.name_);
+		}
+		file_->WriteUByte(TELEMETRY_RECORD_SAMPLE);
+		file_->WriteUInt(sample.frame_);
+		file_->WriteStringHash(nameHash);
+		file_->WriteFloat(sample.value_);
+	}
+};
+
+Telemetry::Telemetry(Context* context, unsigned capacity) :
+	Object(context),
+	ring_(capacity),
+	writer_(0),
+	enabled_(false),
+	frame_(0),
+	dropped_(0)
+{
+	SubscribeToEvent(E_BEGINFRAME, URHO3D_HANDLER(Telemetry, HandleBeginFrame));
+	SubscribeToEvent(E_POSTRENDERUPDATE, URHO3D_HANDLER(Telemetry, HandlePostRenderUpdate));
+	SubscribeToEvent(E_ENDFRAME, URHO3D_HANDLER(Telemetry, HandleEndFrame));
+}
+
+Telemetry::~Telemetry()
+{
+	Close();
+}
+
+bool Telemetry::Open(const String& fileName)
+{
+	Close();
+
+	SharedPtr<File> file(new File(context_));
+	if (!file->Open(fileName, FILE_WRITE))
+	{
+		URHO3D_LOGERROR("Could not open telemetry file " + fileName);
+		return false;
+	}
+
+	writer_ = new TelemetryWriter(this, file, fileName.EndsWith(".csv", false));
+	SetEnabled(true);
+	writer_->Run();
+	URHO3D_LOGINFOF("Telemetry: writing to %s (%u samples, %u bytes)", fileName.CString(), ring_.GetCapacity(),
+		ring_.GetMemoryUse());
+	return true;
+}
+
+void Telemetry::Close()
+{
+	if (!writer_)
+		return;
+
+	SetEnabled(false);
+	writer_->Stop();
+	// Producers on other threads may have pushed after the last drain
+	writer_->Drain();
+	writer_->GetFile()->Close();
+	delete writer_;
+	writer_ = 0;
+
+	unsigned dropped = GetDropped();
+	if (dropped)
+		URHO3D_LOGWARNINGF("Telemetry: %u samples dropped because the ring was full", dropped);
+}
+
+void Telemetry::HandleBeginFrame(StringHash eventType, VariantMap& eventData)
+{
+	using namespace BeginFrame;
+
+	frameTimer_.Reset();
+	frame_.store(eventData[P_FRAMENUMBER].GetUInt(), std::memory_order_relaxed);
+	Record("frame.timestep", eventData[P_TIMESTEP].GetFloat() * 1000.0f);
+}
+
+void Telemetry::HandlePostRenderUpdate(StringHash eventType, VariantMap& eventData)
+{
+	Record("frame.update", frameTimer_.GetUSec(false) / 1000.0f);
+}
+
+void Telemetry::HandleEndFrame(StringHash eventType, VariantMap& eventData)
+{
+	Record("frame.cpu", frameTimer_.GetUSec(false) / 1000.0f);
+}
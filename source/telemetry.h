@@ -0,0 +1,134 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <atomic>
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Core/Timer.h>
+
+using namespace Urho3D;
+
+class TelemetryWriter;
+
+/// One telemetry record. The name must point to a string with static storage (a literal), so recording never
+/// copies or allocates.
+struct TelemetrySample
+{
+	const char* name_;
+	unsigned frame_;
+	float value_;
+};
+
+/// Fixed-capacity multi-producer, single-consumer ring of samples. Memory is allocated once on construction;
+/// Push() and Pop() are lock-free and never allocate. A full ring rejects the sample instead of blocking.
+class TelemetryRing
+{
+public:
+	/// Construct with capacity rounded up to a power of two.
+	TelemetryRing(unsigned capacity);
+	~TelemetryRing();
+
+	/// Add a sample from any thread. Returns false if the ring is full.
+	bool Push(const TelemetrySample& sample);
+	/// Remove the oldest sample. Must only be called from one thread at a time.
+	bool Pop(TelemetrySample& sample);
+
+	unsigned GetCapacity() const { return mask_ + 1; }
+	/// Return resident size of the ring in bytes.
+	unsigned GetMemoryUse() const { return (mask_ + 1) * sizeof(Cell); }
+
+private:
+	struct Cell
+	{
+		std::atomic<unsigned> sequence_;
+		TelemetrySample sample_;
+	};
+
+	Cell* cells_;
+	unsigned mask_;
+	// Producer and consumer positions live on separate cache lines
+	char padding0_[64];
+	std::atomic<unsigned> enqueuePos_;
+	char padding1_[64];
+	unsigned dequeuePos_;
+};
+
+/// Telemetry subsystem. Records the timestep and update duration of every frame, plus any scoped timer samples,
+/// into a TelemetryRing which a background thread drains to a CSV (".csv") or compact binary file.
+class Telemetry : public Object
+{
+	URHO3D_OBJECT(Telemetry, Object);
+
+public:
+	/// Construct.
+	Telemetry(Context* context, unsigned capacity = 16384);
+	/// Destruct. Flushes and closes the output file.
+	~Telemetry();
+
+	/// Start draining to a file. Recording is enabled while a file is open.
+	bool Open(const String& fileName);
+	/// Stop the drain thread, write out what is left and close the file.
+	void Close();
+	/// Enable or disable recording without a file; samples are then only removed with Pop().
+	void SetEnabled(bool enable) { enabled_.store(enable, std::memory_order_relaxed); }
+
+	/// Record a sample for the current frame. Safe to call from any thread.
+	void Record(const char* name, float value)
+	{
+		if (!enabled_.load(std::memory_order_relaxed))
+			return;
+		TelemetrySample sample = { name, frame_.load(std::memory_order_relaxed), value };
+		if (!ring_.Push(sample))
+			dropped_.fetch_add(1, std::memory_order_relaxed);
+	}
+	/// Remove the oldest sample. Used by the drain thread; do not call while a file is open.
+	bool Pop(TelemetrySample& sample) { return ring_.Pop(sample); }
+
+	bool IsEnabled() const { return enabled_.load(std::memory_order_relaxed); }
+	/// Return number of samples lost because the ring was full.
+	unsigned GetDropped() const { return dropped_.load(std::memory_order_relaxed); }
+	const TelemetryRing& GetRing() const { return ring_; }
+
+private:
+	TelemetryRing ring_;
+	TelemetryWriter* writer_;
+	std::atomic<bool> enabled_;
+	std::atomic<unsigned> frame_;
+	std::atomic<unsigned> dropped_;
+	// Timer reset at the start of every frame
+	HiresTimer frameTimer_;
+
+	// Handle frame begin
+	void HandleBeginFrame(StringHash eventType, VariantMap& eventData);
+	// Handle end of the update phase
+	void HandlePostRenderUpdate(StringHash eventType, VariantMap& eventData);
+	// Handle frame end
+	void HandleEndFrame(StringHash eventType, VariantMap& eventData);
+};
+
+/// Records the lifetime of a scope, in milliseconds, as a named telemetry sample.
+class TelemetryScope
+{
+public:
+	TelemetryScope(Telemetry* telemetry, const char* name) :
+		telemetry_(telemetry),
+		name_(name)
+	{
+	}
+
+	~TelemetryScope()
+	{
+		if (telemetry_)
+			telemetry_->Record(name_, timer_.GetUSec(false) / 1000.0f);
+	}
+
+private:
+	Telemetry* telemetry_;
+	const char* name_;
+	HiresTimer timer_;
+};
+
+/// Time the enclosing scope. Usable inside any Object member function; name must be a string literal.
+#define TELEMETRY_SCOPE(name) TelemetryScope telemetryScope_(GetSubsystem<Telemetry>(), name)
+
+#endif
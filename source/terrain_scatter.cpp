@@ -0,0 +1,413 @@
+#include <Urho3D/Container/Sort.h>
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/Core/WorkQueue.h>
+#include <Urho3D/Graphics/Camera.h>
+#include <Urho3D/Graphics/Material.h>
+#include <Urho3D/Graphics/Model.h>
+#include <Urho3D/Graphics/StaticModelGroup.h>
+#include <Urho3D/Graphics/Terrain.h>
+#include <Urho3D/Math/Frustum.h>
+#include <Urho3D/Resource/Image.h>
+#include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/Scene/Node.h>
+
+#include "telemetry.h"
+#include "terrain_scatter.h"
+
+using namespace Urho3D;
+
+// Default most instance nodes created per frame; a dense chunk can hold thousands
+static const unsigned SCATTER_DEFAULT_ACTIVATION_QUOTA = 1000;
+// Chunks are deactivated a little beyond the draw distance so a camera on the boundary does not thrash them
+static const float SCATTER_DEACTIVATE_MARGIN = 1.1f;
+// Values per layer in the layers attribute, after the leading layer count
+static const unsigned SCATTER_LAYER_ATTR_SIZE = 6;
+
+/// Small deterministic generator, one per chunk and layer, so results do not depend on thread scheduling.
+class ScatterRandom
+{
+public:
+	ScatterRandom(unsigned seed) :
+		state_(seed * 0x9e3779b9u + 0x6a09e667u)
+	{
+		Next();
+	}
+
+	unsigned Next()
+	{
+		// xorshift32
+		state_ ^= state_ << 13;
+		state_ ^= state_ >> 17;
+		state_ ^= state_ << 5;
+		return state_;
+	}
+
+	/// Return a float in [0, 1).
+	float Float() { return (Next() >> 8) / 16777216.0f; }
+
+private:
+	unsigned state_;
+};
+
+float TerrainScatter::HeightSampler::GetHeight(float worldX, float worldZ) const
+{
+	// Same interpolation as Terrain::GetHeight(), on a copy of its state so it can run on any thread
+	Vector3 position = inverseTransform_ * Vector3(worldX, 0.0f, worldZ);
+	float xPos = Clamp((position.x_ - origin_.x_) / spacing_.x_, 0.0f, (float)(numVertices_.x_ - 1));
+	float zPos = Clamp((position.z_ - origin_.y_) / spacing_.z_, 0.0f, (float)(numVertices_.y_ - 1));
+	int x = Min((int)xPos, numVertices_.x_ - 2);
+	int z = Min((int)zPos, numVertices_.y_ - 2);
+	float xFrac = xPos - x;
+	float zFrac = zPos - z;
+
+	const float* row = heights_.Get() + z * numVertices_.x_;
+	const float* nextRow = row + numVertices_.x_;
+	float h;
+	if (xFrac + zFrac >= 1.0f)
+	{
+		xFrac = 1.0f - xFrac;
+		zFrac = 1.0f - zFrac;
+		h = nextRow[x + 1] * (1.0f - xFrac - zFrac) + nextRow[x] * xFrac + row[x + 1] * zFrac;
+	}
+	else
+		h = row[x] * (1.0f - xFrac - zFrac) + row[x + 1] * xFrac + nextRow[x] * zFrac;
+
+	return (transform_ * Vector3(position.x_, h, position.z_)).y_;
+}
+
+TerrainScatter::TerrainScatter(Context* context) :
+	LogicComponent(context),
+	chunkSize_(64.0f),
+	drawDistance_(250.0f),
+	seed_(1),
+	activationQuota_(SCATTER_DEFAULT_ACTIVATION_QUOTA),
+	numInstances_(0),
+	numActiveChunks_(0),
+	generatePending_(false)
+{
+	SetUpdateEventMask(USE_UPDATE);
+}
+
+TerrainScatter::~TerrainScatter()
+{
+	ClearChunks();
+}
+
+void TerrainScatter::RegisterObject(Context* context)
+{
+	context->RegisterFactory<TerrainScatter>();
+
+	URHO3D_ACCESSOR_ATTRIBUTE("Is Enabled", IsEnabled, SetEnabled, bool, true, AM_DEFAULT);
+	URHO3D_ACCESSOR_ATTRIBUTE("Chunk Size", GetChunkSize, SetChunkSize, float, 64.0f, AM_DEFAULT);
+	URHO3D_ACCESSOR_ATTRIBUTE("Draw Distance", GetDrawDistance, SetDrawDistance, float, 250.0f, AM_DEFAULT);
+	URHO3D_ACCESSOR_ATTRIBUTE("Seed", GetSeed, SetSeed, unsigned, 1, AM_DEFAULT);
+	URHO3D_MIXED_ACCESSOR_ATTRIBUTE("Layers", GetLayersAttr, SetLayersAttr, VariantVector, Variant::emptyVariantVector,
+		AM_FILE);
+}
+
+void TerrainScatter::ApplyAttributes()
+{
+	// Chunk size, seed or layers may have changed
+	generatePending_ = !layers_.Empty();
+}
+
+void TerrainScatter::DelayedStart()
+{
+	if (chunks_.Empty() && !layers_.Empty())
+		generatePending_ = true;
+}
+
+void TerrainScatter::SetLayersAttr(const VariantVector& value)
+{
+	ResourceCache* cache = GetSubsystem<ResourceCache>();
+	RemoveAllLayers();
+
+	unsigned index = 0;
+	const unsigned numLayers = index < value.Size() ? value[index++].GetUInt() : 0;
+	for (unsigned i = 0; i < numLayers && index + SCATTER_LAYER_ATTR_SIZE <= value.Size(); ++i)
+	{
+		ScatterLayer layer;
+		const ResourceRef& modelRef = value[index++].GetResourceRef();
+		const ResourceRef& materialRef = value[index++].GetResourceRef();
+		const ResourceRef& densityMapRef = value[index++].GetResourceRef();
+		layer.model_ = modelRef.name_.Empty() ? 0 : cache->GetResource<Model>(modelRef.name_);
+		layer.material_ = materialRef.name_.Empty() ? 0 : cache->GetResource<Material>(materialRef.name_);
+		layer.densityMap_ = densityMapRef.name_.Empty() ? 0 : cache->GetResource<Image>(densityMapRef.name_);
+		layer.density_ = value[index++].GetFloat();
+		layer.minScale_ = value[index++].GetFloat();
+		layer.maxScale_ = value[index++].GetFloat();
+		layers_.Push(layer);
+	}
+}
+
+VariantVector TerrainScatter::GetLayersAttr() const
+{
+	VariantVector ret;
+	ret.Reserve(1 + layers_.Size() * SCATTER_LAYER_ATTR_SIZE);
+	ret.Push(layers_.Size());
+	for (unsigned i = 0; i < layers_.Size(); ++i)
+	{
+		const ScatterLayer& layer = layers_[i];
+		ret.Push(GetResourceRef(layer.model_, Model::GetTypeStatic()));
+		ret.Push(GetResourceRef(layer.material_, Material::GetTypeStatic()));
+		ret.Push(GetResourceRef(layer.densityMap_, Image::GetTypeStatic()));
+		ret.Push(layer.density_);
+		ret.Push(layer.minScale_);
+		ret.Push(layer.maxScale_);
+	}
+	return ret;
+}
+
+void TerrainScatter::AddLayer(const ScatterLayer& layer)
+{
+	layers_.Push(layer);
+}
+
+void TerrainScatter::RemoveAllLayers()
+{
+	ClearChunks();
+	layers_.Clear();
+}
+
+void TerrainScatter::SetCamera(Camera* camera)
+{
+	camera_ = camera;
+}
+
+void TerrainScatter::SetChunkSize(float size)
+{
+	chunkSize_ = Max(size, 1.0f);
+}
+
+bool TerrainScatter::Generate(bool parallel)
+{
+	Terrain* terrain = node_ ? node_->GetComponent<Terrain>() : 0;
+	if (!terrain || !terrain->GetHeightData())
+		return false;
+	TELEMETRY_SCOPE("scatter.generate");
+
+	ClearChunks();
+	generatePending_ = false;
+
+	const IntVector2& numPatches = terrain->GetNumPatches();
+	const float patchSize = (float)terrain->GetPatchSize();
+	sampler_.heights_ = terrain->GetHeightData();
+	sampler_.numVertices_ = terrain->GetNumVertices();
+	sampler_.spacing_ = terrain->GetSpacing();
+	sampler_.origin_ = Vector2(-0.5f * numPatches.x_ * patchSize * sampler_.spacing_.x_,
+		-0.5f * numPatches.y_ * patchSize * sampler_.spacing_.z_);
+	sampler_.transform_ = node_->GetWorldTransform();
+	sampler_.inverseTransform_ = sampler_.transform_.Inverse();
+
+	// World-space XZ bounds of the terrain, split into square chunks
+	BoundingBox bounds(Vector3(sampler_.origin_.x_, 0.0f, sampler_.origin_.y_),
+		Vector3(sampler_.origin_.x_ + (sampler_.numVertices_.x_ - 1) * sampler_.spacing_.x_, 0.0f,
+		sampler_.origin_.y_ + (sampler_.numVertices_.y_ - 1) * sampler_.spacing_.z_));
+	bounds = bounds.Transformed(sampler_.transform_);
+	gridOrigin_ = Vector2(bounds.min_.x_, bounds.min_.z_);
+	gridSize_ = Vector2(bounds.max_.x_ - bounds.min_.x_, bounds.max_.z_ - bounds.min_.z_);
+	numChunks_ = IntVector2(Max(CeilToInt(gridSize_.x_ / chunkSize_), 1),
+		Max(CeilToInt(gridSize_.y_ / chunkSize_), 1));
+
+	const unsigned count = (unsigned)(numChunks_.x_ * numChunks_.y_);
+	chunks_.Resize(count);
+	for (unsigned i = 0; i < count; ++i)
+		chunks_[i].layers_.Resize(layers_.Size());
+
+	WorkQueue* queue = GetSubsystem<WorkQueue>();
+	if (parallel && queue)
+	{
+		PODVector<ChunkJob> jobs(count);
+		for (unsigned i = 0; i < count; ++i)
+		{
+			jobs[i].owner_ = this;
+			jobs[i].chunk_ = i;
+			SharedPtr<WorkItem> item(new WorkItem());
+			item->workFunction_ = GenerateChunkWork;
+			item->aux_ = &jobs[i];
+			// Highest priority lets the main thread take part while it waits in Complete()
+			item->priority_ = M_MAX_UNSIGNED;
+			queue->AddWorkItem(item);
+		}
+		queue->Complete(M_MAX_UNSIGNED);
+	}
+	else
+	{
+		for (unsigned i = 0; i < count; ++i)
+			GenerateChunk(i);
+	}
+
+	numInstances_ = 0;
+	for (unsigned i = 0; i < count; ++i)
+	{
+		for (unsigned j = 0; j < chunks_[i].layers_.Size(); ++j)
+			numInstances_ += chunks_[i].layers_[j].positions_.Size();
+	}
+	return true;
+}
+
+void TerrainScatter::GenerateChunkWork(const WorkItem* item, unsigned threadIndex)
+{
+	ChunkJob* job = reinterpret_cast<ChunkJob*>(item->aux_);
+	job->owner_->GenerateChunk(job->chunk_);
+}
+
+void TerrainScatter::GenerateChunk(unsigned index)
+{
+	ScatterChunk& chunk = chunks_[index];
+	const float x0 = gridOrigin_.x_ + (index % numChunks_.x_) * chunkSize_;
+	const float z0 = gridOrigin_.y_ + (index / numChunks_.x_) * chunkSize_;
+	// Edge chunks extend past the terrain
+	const float width = Min(chunkSize_, gridOrigin_.x_ + gridSize_.x_ - x0);
+	const float depth = Min(chunkSize_, gridOrigin_.y_ + gridSize_.y_ - z0);
+
+	for (unsigned l = 0; l < layers_.Size(); ++l)
+	{
+		const ScatterLayer& layer = layers_[l];
+		ScatterInstances& instances = chunk.layers_[l];
+		ScatterRandom random(seed_ ^ (index * 0x01000193u + l * 0x9e3779b9u));
+
+		float expected = layer.density_ * width * depth;
+		unsigned candidates = (unsigned)expected + (random.Float() < expected - (unsigned)expected ? 1 : 0);
+		instances.positions_.Reserve(candidates);
+		instances.rotations_.Reserve(candidates);
+		instances.scales_.Reserve(candidates);
+
+		const float radius = layer.model_ ? layer.model_->GetBoundingBox().HalfSize().Length() : 0.0f;
+		const Image* densityMap = layer.densityMap_;
+		for (unsigned i = 0; i < candidates; ++i)
+		{
+			float x = x0 + random.Float() * width;
+			float z = z0 + random.Float() * depth;
+			if (densityMap)
+			{
+				// Image rows run towards -Z, as in Terrain
+				int px = (int)((x - gridOrigin_.x_) / gridSize_.x_ * densityMap->GetWidth());
+				int py = (int)((1.0f - (z - gridOrigin_.y_) / gridSize_.y_) * densityMap->GetHeight());
+				float density = densityMap->GetPixel(Clamp(px, 0, densityMap->GetWidth() - 1),
+					Clamp(py, 0, densityMap->GetHeight() - 1)).r_;
+				if (random.Float() >= density)
+					continue;
+			}
+
+			Vector3 position(x, sampler_.GetHeight(x, z), z);
+			float scale = Lerp(layer.minScale_, layer.maxScale_, random.Float());
+			instances.positions_.Push(position);
+			instances.rotations_.Push(random.Float() * 360.0f);
+			instances.scales_.Push(scale);
+			Vector3 extent = Vector3::ONE * (radius * scale);
+			chunk.box_.Merge(BoundingBox(position - extent, position + extent));
+		}
+	}
+}
+
+void TerrainScatter::CullChunks(const Frustum& frustum, PODVector<unsigned>& visibleChunks) const
+{
+	visibleChunks.Clear();
+	for (unsigned i = 0; i < chunks_.Size(); ++i)
+	{
+		if (chunks_[i].box_.Defined() && frustum.IsInsideFast(chunks_[i].box_) != OUTSIDE)
+			visibleChunks.Push(i);
+	}
+}
+
+void TerrainScatter::Update(float timeStep)
+{
+	// Retried every frame until the Terrain on the node has loaded its height map
+	if (generatePending_)
+		Generate();
+	if (!camera_ || chunks_.Empty())
+		return;
+	TELEMETRY_SCOPE("scatter.update");
+
+	const Vector3 cameraPosition = camera_->GetNode()->GetWorldPosition();
+	Vector<Pair<float, unsigned> > toActivate;
+	for (unsigned i = 0; i < chunks_.Size(); ++i)
+	{
+		ScatterChunk& chunk = chunks_[i];
+		if (!chunk.box_.Defined())
+			continue;
+		Vector3 closest(Clamp(cameraPosition.x_, chunk.box_.min_.x_, chunk.box_.max_.x_),
+			Clamp(cameraPosition.y_, chunk.box_.min_.y_, chunk.box_.max_.y_),
+			Clamp(cameraPosition.z_, chunk.box_.min_.z_, chunk.box_.max_.z_));
+		float distance = (cameraPosition - closest).Length();
+		if (chunk.node_ && distance > drawDistance_ * SCATTER_DEACTIVATE_MARGIN)
+			DeactivateChunk(chunk);
+		else if (!chunk.IsComplete() && distance <= drawDistance_)
+			toActivate.Push(MakePair(distance, i));
+	}
+
+	// Nearest first, partly built chunks included, until this frame's node quota is used up
+	Sort(toActivate.Begin(), toActivate.End());
+	unsigned quota = activationQuota_;
+	for (unsigned i = 0; i < toActivate.Size() && quota; ++i)
+		quota -= ActivateChunk(chunks_[toActivate[i].second_], quota);
+}
+
+unsigned TerrainScatter::ActivateChunk(ScatterChunk& chunk, unsigned quota)
+{
+	if (!chunk.node_)
+	{
+		Node* chunkNode = node_->CreateChild("ScatterChunk", LOCAL);
+		chunkNode->SetTemporary(true);
+		chunk.node_ = chunkNode;
+		chunk.activeLayer_ = 0;
+		chunk.activeInstance_ = 0;
+		chunk.group_.Reset();
+		++numActiveChunks_;
+	}
+
+	unsigned created = 0;
+	while (chunk.activeLayer_ < chunk.layers_.Size() && created < quota)
+	{
+		const ScatterInstances& instances = chunk.layers_[chunk.activeLayer_];
+		const ScatterLayer& layer = layers_[chunk.activeLayer_];
+		if (!instances.positions_.Empty() && layer.model_)
+		{
+			if (!chunk.group_)
+			{
+				StaticModelGroup* group = chunk.node_->CreateComponent<StaticModelGroup>(LOCAL);
+				group->SetModel(layer.model_);
+				group->SetMaterial(layer.material_);
+				chunk.group_ = group;
+			}
+			StaticModelGroup* group = chunk.group_;
+			for (; chunk.activeInstance_ < instances.positions_.Size() && created < quota; ++chunk.activeInstance_)
+			{
+				const unsigned i = chunk.activeInstance_;
+				Node* instanceNode = chunk.node_->CreateChild(String::EMPTY, LOCAL);
+				instanceNode->SetWorldTransform(instances.positions_[i], Quaternion(instances.rotations_[i], Vector3::UP),
+					instances.scales_[i]);
+				group->AddInstanceNode(instanceNode);
+				++created;
+			}
+			if (chunk.activeInstance_ < instances.positions_.Size())
+				break;
+		}
+		++chunk.activeLayer_;
+		chunk.activeInstance_ = 0;
+		chunk.group_.Reset();
+	}
+	return created;
+}
+
+void TerrainScatter::DeactivateChunk(ScatterChunk& chunk)
+{
+	if (!chunk.node_)
+		return;
+	chunk.node_->Remove();
+	chunk.node_.Reset();
+	chunk.group_.Reset();
+	chunk.activeLayer_ = 0;
+	chunk.activeInstance_ = 0;
+	--numActiveChunks_;
+}
+
+void TerrainScatter::ClearChunks()
+{
+	for (unsigned i = 0; i < chunks_.Size(); ++i)
+		DeactivateChunk(chunks_[i]);
+	chunks_.Clear();
+	numInstances_ = 0;
+	numActiveChunks_ = 0;
+}
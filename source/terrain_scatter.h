@@ -0,0 +1,186 @@
+#ifndef TERRAIN_SCATTER_H
+#define TERRAIN_SCATTER_H
+
+#include <Urho3D/Container/ArrayPtr.h>
+#include <Urho3D/Math/BoundingBox.h>
+#include <Urho3D/Math/Matrix3x4.h>
+#include <Urho3D/Scene/LogicComponent.h>
+
+using namespace Urho3D;
+
+namespace Urho3D
+{
+	class Camera;
+	class Frustum;
+	class Image;
+	class Material;
+	class Model;
+	class StaticModelGroup;
+	class Terrain;
+	class WorkItem;
+}
+
+/// One kind of scattered prop.
+struct ScatterLayer
+{
+	SharedPtr<Model> model_;
+	SharedPtr<Material> material_;
+	/// Placement probability over the terrain from the red channel, 0 to 1. Null places everywhere.
+	SharedPtr<Image> densityMap_;
+	/// Candidate instances per square world unit where the density map is 1.
+	float density_;
+	float minScale_;
+	float maxScale_;
+};
+
+/// Instances of one layer in one chunk, as parallel arrays.
+struct ScatterInstances
+{
+	PODVector<Vector3> positions_;
+	/// Rotation around Y in degrees.
+	PODVector<float> rotations_;
+	PODVector<float> scales_;
+};
+
+/// Square region of the terrain holding the instances of every layer that fall inside it.
+struct ScatterChunk
+{
+	/// Construct.
+	ScatterChunk() :
+		activeLayer_(0),
+		activeInstance_(0)
+	{
+	}
+
+	/// Return whether every instance of the chunk has its node.
+	bool IsComplete() const { return node_ && activeLayer_ >= layers_.Size(); }
+
+	/// World-space bounds of all instances in the chunk.
+	BoundingBox box_;
+	/// Instances per layer.
+	Vector<ScatterInstances> layers_;
+	/// Node holding one StaticModelGroup per layer while the chunk is within draw distance.
+	WeakPtr<Node> node_;
+	/// Layer and instance the next activation slice starts at.
+	unsigned activeLayer_;
+	unsigned activeInstance_;
+	/// Group of the layer being activated.
+	WeakPtr<StaticModelGroup> group_;
+};
+
+/// Scatters props over the Terrain on the same node. Instances are generated on WorkQueue threads, one work item
+/// per chunk, and kept in per-chunk arrays rather than as scene nodes. Chunks within draw distance of the camera get
+/// a StaticModelGroup per layer, so each visible chunk draws as one instanced batch per model and the Octree culls
+/// whole chunks; chunks further away exist only as data. StaticModelGroup takes its instance transforms from nodes,
+/// so an active chunk still holds one (component-less) node per instance; to bound the cost of creating them,
+/// activation is spread over frames under a per-frame node quota, resuming partly built chunks nearest first. Layers are saved with the scene; a loaded or edited
+/// component regenerates its instances on the next update once the Terrain has height data.
+class TerrainScatter : public LogicComponent
+{
+	URHO3D_OBJECT(TerrainScatter, LogicComponent);
+
+public:
+	/// Construct.
+	TerrainScatter(Context* context);
+	/// Destruct.
+	virtual ~TerrainScatter();
+	/// Register object factory and attributes.
+	static void RegisterObject(Context* context);
+
+	/// Apply attribute changes that can not be applied immediately. Schedules regeneration.
+	virtual void ApplyAttributes();
+	/// Schedule generation of layers added before the first update.
+	virtual void DelayedStart();
+	/// Generate if scheduled, then activate and deactivate chunks around the camera.
+	virtual void Update(float timeStep);
+
+	/// Add a layer. Takes effect on the next Generate().
+	void AddLayer(const ScatterLayer& layer);
+	/// Remove all layers and instances.
+	void RemoveAllLayers();
+	/// Generate instances for all layers. Blocks until done; parallel uses the WorkQueue threads, otherwise runs on
+	/// the calling thread. Returns false if there is no Terrain on the node.
+	bool Generate(bool parallel = true);
+	/// Collect indices of chunks whose bounds intersect the frustum.
+	void CullChunks(const Frustum& frustum, PODVector<unsigned>& visibleChunks) const;
+
+	/// Set camera that decides which chunks are within draw distance.
+	void SetCamera(Camera* camera);
+	/// Set chunk edge length in world units.
+	void SetChunkSize(float size);
+	/// Set distance from the camera within which chunks get renderable instances.
+	void SetDrawDistance(float distance) { drawDistance_ = Max(distance, 0.0f); }
+	/// Set random seed; the same seed and layers always give the same instances.
+	void SetSeed(unsigned seed) { seed_ = seed; }
+	/// Set the most instance nodes created per frame when activating chunks.
+	void SetActivationQuota(unsigned nodes) { activationQuota_ = Max(nodes, 1U); }
+
+	float GetChunkSize() const { return chunkSize_; }
+	unsigned GetActivationQuota() const { return activationQuota_; }
+	float GetDrawDistance() const { return drawDistance_; }
+	unsigned GetSeed() const { return seed_; }
+	const Vector<ScatterLayer>& GetLayers() const { return layers_; }
+	const Vector<ScatterChunk>& GetChunks() const { return chunks_; }
+	/// Return total number of instances.
+	unsigned GetNumInstances() const { return numInstances_; }
+	/// Return number of chunks with renderable instances.
+	unsigned GetNumActiveChunks() const { return numActiveChunks_; }
+
+	/// Set layers attribute: layer count, then model, material, density map, density, min scale and max scale for
+	/// each layer.
+	void SetLayersAttr(const VariantVector& value);
+	/// Return layers attribute.
+	VariantVector GetLayersAttr() const;
+
+private:
+	/// Copy of what is needed to sample terrain height off the main thread.
+	struct HeightSampler
+	{
+		SharedArrayPtr<float> heights_;
+		IntVector2 numVertices_;
+		Vector3 spacing_;
+		Vector2 origin_;
+		Matrix3x4 transform_;
+		Matrix3x4 inverseTransform_;
+
+		float GetHeight(float worldX, float worldZ) const;
+	};
+
+	/// Work item payload.
+	struct ChunkJob
+	{
+		TerrainScatter* owner_;
+		unsigned chunk_;
+	};
+
+	Vector<ScatterLayer> layers_;
+	Vector<ScatterChunk> chunks_;
+	WeakPtr<Camera> camera_;
+	HeightSampler sampler_;
+	// World-space XZ corner of chunk (0, 0), extent of the terrain and the chunk grid size
+	Vector2 gridOrigin_;
+	Vector2 gridSize_;
+	IntVector2 numChunks_;
+	float chunkSize_;
+	float drawDistance_;
+	unsigned seed_;
+	unsigned activationQuota_;
+	unsigned numInstances_;
+	unsigned numActiveChunks_;
+	// Generate() runs on the next update that finds the Terrain's height data
+	bool generatePending_;
+
+	// Fill one chunk. Only touches chunks_[index], so chunks can be generated concurrently
+	void GenerateChunk(unsigned index);
+	// Create up to quota instance nodes for a chunk, continuing where the last call stopped. Returns nodes created
+	unsigned ActivateChunk(ScatterChunk& chunk, unsigned quota);
+	// Remove a chunk's instance nodes
+	void DeactivateChunk(ScatterChunk& chunk);
+	// Remove all chunks
+	void ClearChunks();
+
+	// Worker thread entry point
+	static void GenerateChunkWork(const WorkItem* item, unsigned threadIndex);
+};
+
+#endif